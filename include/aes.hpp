@@ -0,0 +1,224 @@
+#ifndef aes_hpp
+#define aes_hpp
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CRYPTO_AES_NI 1
+#endif
+
+namespace crypto
+{
+    // aes-256 encryption, all counter mode needs
+    // a table based software path and an aes-ni path, picked at run time
+    namespace aes
+    {
+        // the s-box and the four round tables, built once from the field arithmetic
+        struct tables
+        {
+            uint8_t sbox[256];
+            uint32_t te[4][256];
+
+            tables()
+            {
+                // p walks the multiplicative group by 3, q = p^-1 walks it by 3^-1
+                uint8_t p = 1, q = 1;
+                do
+                {
+                    p = p ^ (uint8_t)(p << 1) ^ (p & 0x80 ? 0x1b : 0);
+                    q ^= q << 1;
+                    q ^= q << 2;
+                    q ^= q << 4;
+                    if (q & 0x80)
+                    {
+                        q ^= 0x09;
+                    }
+                    uint8_t x = q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4);
+                    sbox[p] = x ^ 0x63;
+                } while (p != 1);
+                sbox[0] = 0x63;
+
+                for (int i = 0; i < 256; i++)
+                {
+                    uint32_t s = sbox[i], s2 = (uint8_t)(s << 1) ^ (s & 0x80 ? 0x1b : 0);
+                    uint32_t w = s2 << 24 | s << 16 | s << 8 | (s2 ^ s);
+                    for (int t = 0; t < 4; t++)
+                    {
+                        te[t][i] = w;
+                        w = w >> 8 | w << 24;
+                    }
+                }
+            }
+
+            static uint8_t rotl8(uint8_t x, int n)
+            {
+                return x << n | x >> (8 - n);
+            }
+        };
+
+        const tables &table()
+        {
+            static const tables t;
+            return t;
+        }
+
+        inline uint32_t loadBe(const uint8_t *p)
+        {
+            return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        }
+
+        inline void storeBe(uint8_t *p, uint32_t v)
+        {
+            p[0] = v >> 24;
+            p[1] = v >> 16;
+            p[2] = v >> 8;
+            p[3] = v;
+        }
+
+        // the 15 round keys of an aes-256 key, as words for the tables
+        // and as bytes in the order aes-ni loads them
+        struct key256
+        {
+            uint32_t words[60];
+            uint8_t bytes[240];
+        };
+
+        void expandKey(key256 &k, const uint8_t key[32])
+        {
+            const uint8_t *s = table().sbox;
+            uint32_t *w = k.words, rcon = 1;
+            for (int i = 0; i < 8; i++)
+            {
+                w[i] = loadBe(key + 4 * i);
+            }
+            for (int i = 8; i < 60; i++)
+            {
+                uint32_t t = w[i - 1];
+                if (i % 8 == 0)
+                {
+                    t = t << 8 | t >> 24;
+                    t = (uint32_t)s[t >> 24] << 24 | (uint32_t)s[t >> 16 & 255] << 16 | (uint32_t)s[t >> 8 & 255] << 8 | s[t & 255];
+                    t ^= rcon << 24;
+                    rcon = (rcon << 1) ^ (rcon & 0x80 ? 0x1b : 0);
+                } else if (i % 8 == 4) {
+                    t = (uint32_t)s[t >> 24] << 24 | (uint32_t)s[t >> 16 & 255] << 16 | (uint32_t)s[t >> 8 & 255] << 8 | s[t & 255];
+                }
+                w[i] = w[i - 8] ^ t;
+            }
+            for (int i = 0; i < 60; i++)
+            {
+                storeBe(k.bytes + 4 * i, w[i]);
+            }
+        }
+
+        void encryptSoftware(const key256 &k, const uint8_t in[16], uint8_t out[16])
+        {
+            const tables &t = table();
+            const uint32_t *rk = k.words;
+            uint32_t s0 = loadBe(in) ^ rk[0], s1 = loadBe(in + 4) ^ rk[1];
+            uint32_t s2 = loadBe(in + 8) ^ rk[2], s3 = loadBe(in + 12) ^ rk[3];
+
+            for (int r = 1; r < 14; r++)
+            {
+                rk += 4;
+                uint32_t t0 = t.te[0][s0 >> 24] ^ t.te[1][s1 >> 16 & 255] ^ t.te[2][s2 >> 8 & 255] ^ t.te[3][s3 & 255] ^ rk[0];
+                uint32_t t1 = t.te[0][s1 >> 24] ^ t.te[1][s2 >> 16 & 255] ^ t.te[2][s3 >> 8 & 255] ^ t.te[3][s0 & 255] ^ rk[1];
+                uint32_t t2 = t.te[0][s2 >> 24] ^ t.te[1][s3 >> 16 & 255] ^ t.te[2][s0 >> 8 & 255] ^ t.te[3][s1 & 255] ^ rk[2];
+                uint32_t t3 = t.te[0][s3 >> 24] ^ t.te[1][s0 >> 16 & 255] ^ t.te[2][s1 >> 8 & 255] ^ t.te[3][s2 & 255] ^ rk[3];
+                s0 = t0;
+                s1 = t1;
+                s2 = t2;
+                s3 = t3;
+            }
+
+            // the last round has no mix columns, just the s-box
+            rk += 4;
+            const uint8_t *s = t.sbox;
+            uint32_t c[4] = {s0, s1, s2, s3};
+            for (int i = 0; i < 4; i++)
+            {
+                uint32_t v = (uint32_t)s[c[i] >> 24] << 24 | (uint32_t)s[c[(i + 1) % 4] >> 16 & 255] << 16
+                           | (uint32_t)s[c[(i + 2) % 4] >> 8 & 255] << 8 | s[c[(i + 3) % 4] & 255];
+                storeBe(out + 4 * i, v ^ rk[i]);
+            }
+        }
+
+        // adds one to a 128 bit big endian counter
+        inline void increment(uint8_t counter[16])
+        {
+            for (int i = 15; i >= 0; i--)
+            {
+                if (++counter[i] != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        void ctrSoftware(const key256 &k, uint8_t counter[16], uint8_t *out, size_t blocks)
+        {
+            for (size_t b = 0; b < blocks; b++, out += 16)
+            {
+                encryptSoftware(k, counter, out);
+                increment(counter);
+            }
+        }
+
+#ifdef CRYPTO_AES_NI
+
+        // eight counter blocks in flight so the aesenc latency overlaps
+        __attribute__((target("aes,sse2")))
+        void ctrNi(const key256 &k, uint8_t counter[16], uint8_t *out, size_t blocks)
+        {
+            __m128i rk[15];
+            for (int i = 0; i < 15; i++)
+            {
+                rk[i] = _mm_loadu_si128((const __m128i *)(k.bytes + 16 * i));
+            }
+
+            while (blocks > 0)
+            {
+                size_t n = blocks < 8 ? blocks : 8;
+                __m128i x[8];
+                for (size_t j = 0; j < n; j++)
+                {
+                    x[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)counter), rk[0]);
+                    increment(counter);
+                }
+                for (int r = 1; r < 14; r++)
+                {
+                    for (size_t j = 0; j < n; j++)
+                    {
+                        x[j] = _mm_aesenc_si128(x[j], rk[r]);
+                    }
+                }
+                for (size_t j = 0; j < n; j++)
+                {
+                    _mm_storeu_si128((__m128i *)(out + 16 * j), _mm_aesenclast_si128(x[j], rk[14]));
+                }
+                out += 16 * n;
+                blocks -= n;
+            }
+        }
+
+#endif
+
+        // blocks of counter mode keystream, E(counter), E(counter + 1) ..., leaving counter past them
+        void ctr(const key256 &k, uint8_t counter[16], uint8_t *out, size_t blocks)
+        {
+#ifdef CRYPTO_AES_NI
+            static const bool ni = __builtin_cpu_supports("aes");
+            if (ni)
+            {
+                ctrNi(k, counter, out, blocks);
+                return;
+            }
+#endif
+            ctrSoftware(k, counter, out, blocks);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef chacha_hpp
+#define chacha_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#define CRYPTO_CHACHA_SSE2 1
+#endif
+
+namespace crypto
+{
+    // the chacha20 stream cipher block function
+    // the original layout: 4 constant words, 8 key words, a 64 bit block
+    // counter in words 12 and 13 and a 64 bit nonce in words 14 and 15
+    namespace chacha
+    {
+        inline uint32_t load32(const uint8_t *p)
+        {
+            return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        }
+
+        inline void store32(uint8_t *p, uint32_t v)
+        {
+            p[0] = v;
+            p[1] = v >> 8;
+            p[2] = v >> 16;
+            p[3] = v >> 24;
+        }
+
+        inline uint32_t rotl(uint32_t v, int n)
+        {
+            return v << n | v >> (32 - n);
+        }
+
+        void init(uint32_t state[16], const uint8_t key[32], uint64_t nonce, uint64_t counter = 0)
+        {
+            static const uint8_t sigma[] = "expand 32-byte k";
+            for (int i = 0; i < 4; i++)
+            {
+                state[i] = load32(sigma + 4 * i);
+            }
+            for (int i = 0; i < 8; i++)
+            {
+                state[4 + i] = load32(key + 4 * i);
+            }
+            state[12] = (uint32_t)counter;
+            state[13] = (uint32_t)(counter >> 32);
+            state[14] = (uint32_t)nonce;
+            state[15] = (uint32_t)(nonce >> 32);
+        }
+
+        uint64_t counter(const uint32_t state[16])
+        {
+            return (uint64_t)state[13] << 32 | state[12];
+        }
+
+        // move the stream to block i, every block is independent of the others
+        void seek(uint32_t state[16], uint64_t block)
+        {
+            state[12] = (uint32_t)block;
+            state[13] = (uint32_t)(block >> 32);
+        }
+
+#define CRYPTO_CHACHA_QUARTER(a, b, c, d) \
+            a += b; d = rotl(d ^ a, 16);  \
+            c += d; b = rotl(b ^ c, 12);  \
+            a += b; d = rotl(d ^ a, 8);   \
+            c += d; b = rotl(b ^ c, 7);
+
+        // the 64 byte block at the state's counter, the counter is left alone
+        void block(const uint32_t state[16], uint8_t out[64])
+        {
+            uint32_t x[16];
+            std::memcpy(x, state, sizeof(x));
+            for (int i = 0; i < 10; i++)
+            {
+                CRYPTO_CHACHA_QUARTER(x[0], x[4], x[8], x[12])
+                CRYPTO_CHACHA_QUARTER(x[1], x[5], x[9], x[13])
+                CRYPTO_CHACHA_QUARTER(x[2], x[6], x[10], x[14])
+                CRYPTO_CHACHA_QUARTER(x[3], x[7], x[11], x[15])
+                CRYPTO_CHACHA_QUARTER(x[0], x[5], x[10], x[15])
+                CRYPTO_CHACHA_QUARTER(x[1], x[6], x[11], x[12])
+                CRYPTO_CHACHA_QUARTER(x[2], x[7], x[8], x[13])
+                CRYPTO_CHACHA_QUARTER(x[3], x[4], x[9], x[14])
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                store32(out + 4 * i, x[i] + state[i]);
+            }
+        }
+
+#undef CRYPTO_CHACHA_QUARTER
+
+#ifdef CRYPTO_CHACHA_SSE2
+
+        inline __m128i rotl4(__m128i v, int n)
+        {
+            return _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - n));
+        }
+
+#define CRYPTO_CHACHA_QUARTER4(a, b, c, d)                                \
+            a = _mm_add_epi32(a, b); d = rotl4(_mm_xor_si128(d, a), 16);  \
+            c = _mm_add_epi32(c, d); b = rotl4(_mm_xor_si128(b, c), 12);  \
+            a = _mm_add_epi32(a, b); d = rotl4(_mm_xor_si128(d, a), 8);   \
+            c = _mm_add_epi32(c, d); b = rotl4(_mm_xor_si128(b, c), 7);
+
+        // four consecutive blocks at once, each register holds one state word of all four
+        void block4(const uint32_t state[16], uint8_t out[256])
+        {
+            __m128i in[16], x[16];
+            uint64_t c = counter(state);
+            for (int i = 0; i < 16; i++)
+            {
+                in[i] = _mm_set1_epi32(state[i]);
+            }
+            in[12] = _mm_setr_epi32((uint32_t)c, (uint32_t)(c + 1), (uint32_t)(c + 2), (uint32_t)(c + 3));
+            in[13] = _mm_setr_epi32((uint32_t)(c >> 32), (uint32_t)((c + 1) >> 32), (uint32_t)((c + 2) >> 32), (uint32_t)((c + 3) >> 32));
+
+            for (int i = 0; i < 16; i++)
+            {
+                x[i] = in[i];
+            }
+            for (int i = 0; i < 10; i++)
+            {
+                CRYPTO_CHACHA_QUARTER4(x[0], x[4], x[8], x[12])
+                CRYPTO_CHACHA_QUARTER4(x[1], x[5], x[9], x[13])
+                CRYPTO_CHACHA_QUARTER4(x[2], x[6], x[10], x[14])
+                CRYPTO_CHACHA_QUARTER4(x[3], x[7], x[11], x[15])
+                CRYPTO_CHACHA_QUARTER4(x[0], x[5], x[10], x[15])
+                CRYPTO_CHACHA_QUARTER4(x[1], x[6], x[11], x[12])
+                CRYPTO_CHACHA_QUARTER4(x[2], x[7], x[8], x[13])
+                CRYPTO_CHACHA_QUARTER4(x[3], x[4], x[9], x[14])
+            }
+
+            // transpose each group of four words back into the four blocks
+            for (int g = 0; g < 4; g++)
+            {
+                __m128i a = _mm_add_epi32(x[4 * g], in[4 * g]);
+                __m128i b = _mm_add_epi32(x[4 * g + 1], in[4 * g + 1]);
+                __m128i c2 = _mm_add_epi32(x[4 * g + 2], in[4 * g + 2]);
+                __m128i d = _mm_add_epi32(x[4 * g + 3], in[4 * g + 3]);
+                __m128i ab0 = _mm_unpacklo_epi32(a, b), ab1 = _mm_unpackhi_epi32(a, b);
+                __m128i cd0 = _mm_unpacklo_epi32(c2, d), cd1 = _mm_unpackhi_epi32(c2, d);
+                _mm_storeu_si128((__m128i *)(out + 16 * g), _mm_unpacklo_epi64(ab0, cd0));
+                _mm_storeu_si128((__m128i *)(out + 64 + 16 * g), _mm_unpackhi_epi64(ab0, cd0));
+                _mm_storeu_si128((__m128i *)(out + 128 + 16 * g), _mm_unpacklo_epi64(ab1, cd1));
+                _mm_storeu_si128((__m128i *)(out + 192 + 16 * g), _mm_unpackhi_epi64(ab1, cd1));
+            }
+        }
+
+#undef CRYPTO_CHACHA_QUARTER4
+
+#endif
+
+        // count blocks of keystream to out, advancing the counter past them
+        void blocks(uint32_t state[16], uint8_t *out, size_t count)
+        {
+            uint64_t c = counter(state);
+#ifdef CRYPTO_CHACHA_SSE2
+            for (; count >= 4; count -= 4, out += 256, c += 4)
+            {
+                block4(state, out);
+                seek(state, c + 4);
+            }
+#endif
+            for (; count > 0; count--, out += 64, c++)
+            {
+                block(state, out);
+                seek(state, c + 1);
+            }
+        }
+
+        // n bytes of key material from an arbitrary seed string
+        // each 32 byte piece of the seed is folded into a running key by one block
+        // with the seed length as nonce, then the output is that key's keystream
+        // deterministic, for turning test seeds into keys, not a general kdf
+        void derive(const std::string &seed, uint8_t *out, size_t n)
+        {
+            uint8_t key[32] = {}, buf[64];
+            uint32_t state[16];
+            for (size_t i = 0; i == 0 || i < seed.size(); i += 32)
+            {
+                for (size_t j = 0; j < 32 && i + j < seed.size(); j++)
+                {
+                    key[j] ^= seed[i + j];
+                }
+                init(state, key, seed.size(), i / 32);
+                block(state, buf);
+                std::memcpy(key, buf, 32);
+            }
+
+            init(state, key, ~(uint64_t)0);
+            for (size_t i = 0; i < n; i += 64)
+            {
+                blocks(state, buf, 1);
+                std::memcpy(out + i, buf, n - i < 64 ? n - i : 64);
+            }
+        }
+    }
+}
+
+#endif
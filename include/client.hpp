@@ -59,9 +59,54 @@ namespace net
             // send public key request
             send(m_serverFd, request, 1, 0);
 
-            // wait for server to respond
+            // wait for server to respond with the key length then the serialized key
+            // perror only when recv failed, a short read means the server hung up and errno is stale
+            uint32_t length;
+            ssize_t got = recv(m_serverFd, &length, sizeof(length), MSG_WAITALL);
+            if (got != sizeof(length))
+            {
+                if (got < 0)
+                {
+                    perror("handshake: could not read public key length");
+                } else {
+                    fprintf(stderr, "handshake: server closed before sending the public key length\n");
+                }
+                exit(EXIT_FAILURE);
+            }
+
+            // a serialized public key is a few hundred bytes, refuse anything absurd before allocating
+            length = ntohl(length);
+            if (length == 0 || length > MAX_PUBKEY_LENGTH)
+            {
+                fprintf(stderr, "handshake: invalid public key length %u\n", length);
+                exit(EXIT_FAILURE);
+            }
+
+            std::string pubkey(length, '\0');
+            got = recv(m_serverFd, &pubkey[0], pubkey.size(), MSG_WAITALL);
+            if (got != (ssize_t)pubkey.size())
+            {
+                if (got < 0)
+                {
+                    perror("handshake: could not read public key");
+                } else {
+                    fprintf(stderr, "handshake: server closed before sending the whole public key\n");
+                }
+                exit(EXIT_FAILURE);
+            }
+
+            // a malformed key fails the handshake like every other error here
             crypto::rsaPublicKey serverPublicKey;
-            read(m_serverFd, &serverPublicKey, sizeof(crypto::rsaPublicKey));
+            try
+            {
+                serverPublicKey = crypto::parsePublicKey((const uint8_t *)pubkey.data(), pubkey.size());
+            } catch (const std::exception &e) {
+                fprintf(stderr, "handshake: invalid public key: %s\n", e.what());
+                exit(EXIT_FAILURE);
+            } catch (const char *e) {
+                fprintf(stderr, "handshake: invalid public key: %s\n", e);
+                exit(EXIT_FAILURE);
+            }
             std::cout << serverPublicKey.n << std::endl;
 
             // delete request byte buffer
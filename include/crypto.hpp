@@ -6,246 +6,446 @@
 #include <iomanip>
 #include <sstream>
 #include <fstream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <types.hpp>
 #include <random.hpp>
+#include <montgomery.hpp>
+#include <primes.hpp>
+#include <signed.hpp>
+#include <gcd.hpp>
+#include <hex.hpp>
+#include <shift.hpp>
 
 namespace crypto
 {
     // calculate gcd of bigint a, bigint b
-    // using euclids algorithm
-    bigint gcd(bigint a, bigint b)
+    // binary gcd for single limb values, lehmer's algorithm above that
+    bigint gcd(const bigint &a, const bigint &b)
     {
-        if (a == b)
-        {
-            return a;
-        }
-
-        return gcd(max(a, b) - min(a, b), min(a, b));
+        static thread_local gcdEngine engine;
+        return engine.gcd(a, b);
     }
 
     // calculate lcm of bigint a, bigint b
-    // uses lcm = |ab| / gcd(a,b)
-    bigint lcm(bigint a, bigint b)
+    // uses lcm = |ab| / gcd(a,b), dividing before multiplying
+    bigint lcm(const bigint &a, const bigint &b)
     {
-        return (a * b) / gcd(a, b);
+        return (a / gcd(a, b)) * b;
     }
 
     // power function
     // performs x^y % p
-    bigint power(bigint x, bigint y, bigint p)
+    bigint power(const bigint &x, const bigint &y, const bigint &p)
     {
-        bigint res = 1;
-        x = x % p;
+        // odd moduli go through montgomery multiplication, no division per step
+        if ((p[0] & 1) && p > 1)
+        {
+            return montgomeryContext(p).modexp(x, y);
+        }
+
+        bigint res = 1, base = x % p;
 
-        while (y > 0)
+        // left to right, reading exponent bits directly
+        // in place operators so every step reuses the same storage
+        for (int i = bitLength(y) - 1; i >= 0; i--)
         {
-            if (y[0] & 1)
+            res *= res;
+            res %= p;
+            if (testBit(y, i))
             {
-                res = (res*x) % p;
+                res *= base;
+                res %= p;
             }
-    
-            divideBy2(y);
-            x = (x*x) % p;
         }
 
         return res;
     }
 
-    // miller rabin prime test
-    bool millerRabin(bigint n, int k, prng &rng)
+    // generates a prime number of k bits
+    // first generate odd number of k bits
+    // then add 2 until prime found, sieving out small factors
+    // so only survivors reach the primality test
+    bigint genPrime(int k, prng &rng)
     {
-        if (n == 2)
+        bigint prime = rng.randbi(k);
+        if (!(prime[0] & 1))
         {
-            return true;
+            prime++;
         }
 
-        if (n % 2 == 0)
+        primeSearch search(prime);
+        do
         {
-            return false;
-        }
+            prime = search.next();
+        } while (!isProbablePrime(prime, rng));
 
-        bigint r, s;
-        r = 0;
-        s = n - 1;
+        return prime;
+    }
 
-        while (s % 2 == 0)
+    // generates a prime number of k bits on several threads
+    // worker i walks start + 2i, start + 2i + 2 threads ... with its own prng,
+    // so the workers never test the same candidate, the first to find a
+    // prime wins and the others stop before their next candidate
+    bigint genPrimeParallel(int k, prng &rng, int threads)
+    {
+        if (threads <= 1)
         {
-            r += 1;
-            s /= 2;
+            return genPrime(k, rng);
         }
 
-        for (int i = 0; i < k; i++)
+        bigint start = rng.randbi(k);
+        if (!(start[0] & 1))
         {
-            bigint a = rng.randbi(2, n - 1);
-            bigint x = power(a, s, n);
+            start++;
+        }
 
-            if (x == 1 || x == (n - 1))
-            {
-                continue;
-            }
+        std::vector<prng> streams;
+        for (int i = 0; i < threads; i++)
+        {
+            streams.push_back(rng.fork());
+        }
 
-            bool found = true;
-            for (bigint j = 0; j < r - 1; j++)
+        std::atomic<bool> found(false);
+        std::mutex lock;
+        bigint prime;
+
+        auto work = [&](int i)
+        {
+            primeSearch search(start + 2 * i, 2 * threads);
+            while (!found)
             {
-                x = power(x, 2, n);
-                if (x == (n - 1))
+                bigint candidate = search.next();
+                if (isProbablePrime(candidate, streams[i]))
                 {
-                    found = false;
-                    break;
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (!found)
+                    {
+                        prime = candidate;
+                        found = true;
+                    }
                 }
             }
+        };
 
-            if (found)
-            {
-                return false;
-            }
-        }
-
-        return true;
-    }
-
-    bool millerRabin2(bigint n, int k, prng &rng);
-    // generates a prime number of k bits
-    // first generate odd number of k bits
-    // then add 2 until prime found
-    bigint genPrime(int k, prng &rng)
-    {
-        bigint prime = rng.randbi(k);
-        if (prime % 2 == 0)
+        std::vector<std::thread> pool;
+        for (int i = 0; i < threads; i++)
         {
-            prime++;
+            pool.emplace_back(work, i);
         }
 
-        do
+        for (std::thread &t : pool)
         {
-            prime += 2;
-        } while (!millerRabin2(prime, 20, rng));
+            t.join();
+        }
 
         return prime;
     }
 
-    // struct used to calculate modular inverse multplicati with unsinged bigints
-    struct bigintAndSign
-    {
-        bigint value;
-        bool isNegative;
-    };
-
     // calcuates the modular inverse multiplicative
+    // extended euclid with signed cofactors and one long division per step
+    // every step works in the storage of the previous ones
+    // returns 0 when a and b are not coprime
     bigint mul_inv(bigint a, bigint b)
     {
-        if (b <= 1)
+        if (b <= 1 || null(a))
             return 0;
 
-        bigint b0 = b;
-        bigintAndSign x0 = { 0, false }; // b = 1*b + 0*a
-        bigintAndSign x1 = { 1, false }; // a = 0*b + 1*a
+        bigint b0 = b, q, r;
+        signedBigint x0 = 0; // b = 1*b + 0*a
+        signedBigint x1 = 1; // a = 0*b + 1*a
+        signedBigint t;
 
-        while (a > 1)
+        // bit tests rather than comparisons against temporaries
+        while (bitLength(a) > 1)
         {
-            if (b == 0) // means original A and B were not co-prime so there is no answer
+            if (null(b)) // means original A and B were not co-prime so there is no answer
                 return 0;
-                
-            bigint q = a / b;
-            // (b, a) := (a % b, b)
-            // which is the same as
-            // (b, a) := (a - q * b, b)
-            bigint t = b; b = a % b; a = t;
-
-            // (x0, x1) := (x1 - q * x0, x0)
-            bigintAndSign t2 = x0;
-            bigint qx0 = q * x0.value;
-            if (x0.isNegative != x1.isNegative)
-            {
-                x0.value = x1.value + qx0;
-                x0.isNegative = x1.isNegative;
-            }
-            else
-            {
-                x0.value = (x1.value > qx0) ? x1.value - qx0 : qx0 - x1.value;
-                x0.isNegative = (x1.value > qx0) ? x1.isNegative : !x0.isNegative;
-            }
-            x1 = t2;
+
+            // (a, b) := (b, a - q * b), (x0, x1) := (x1 - q * x0, x0)
+            // with q and a % b from a single division
+            divmod(a, b, q, r);
+            swap(a, b);
+            swap(b, r);
+
+            t = x0;
+            t *= q;
+            x1 -= t;
+            swap(x0, x1);
         }
 
-        return x1.isNegative ? (b0 - x1.value) : x1.value;
+        return x1.mod(b0);
     }
 
-    // concatinates together byte stings representing text
-    std::string stringToHex(std::string in)
+    // two lowercase hex characters per byte of text
+    std::string stringToHex(const std::string &in)
     {
-        std::string stringHex;
-        for (char c : in)
-        {
-            std::stringstream stream;
-            stream << std::hex << (int)c;
-            stringHex += std::string(stream.str());
-        }
-
-        return stringHex;
+        std::string hex(2 * in.size(), '0');
+        hexEncode((const uint8_t *)in.data(), in.size(), &hex[0]);
+        return hex;
     }
 
     // converts string-hex byte string back to strings
-    std::string hexToString(std::string in)
+    // empty if the length is odd or a character is not a hex digit
+    std::string hexToString(const std::string &in)
     {
         if (in.length() % 2 != 0)
         {
             return "";
         }
 
-        std::string hexString;
+        std::string bytes(in.size() / 2, '\0');
+        if (!hexDecode(in.data(), bytes.size(), (uint8_t *)&bytes[0]))
+        {
+            return "";
+        }
+        return bytes;
+    }
 
-        for (int i = 0; i < in.length(); i+= 2)
+    // one-time pad cipher over a buffer, in place
+    // shifts every byte up by a key byte from rng, mod 256
+    // the key is drawn a block at a time into a stack buffer, so nothing is allocated
+    // encrypt and decrtpy must use 2 seperate random number generator functions with the same seed
+    void ethShiftEncrypt(uint8_t *data, size_t n, prng &rng)
+    {
+        uint8_t key[CRYPTO_SHIFT_BLOCK];
+        for (size_t i = 0; i < n; i += sizeof(key))
         {
-            std::string hexVal = in.substr(i, 2);
-            hexString += std::string(1, (char)std::stoi(hexVal, nullptr, 16));
+            size_t m = std::min(n - i, sizeof(key));
+            rng.fill(key, m);
+            shiftAdd(data + i, key, m);
         }
-        return hexString;
     }
 
-    // one-time pad cipher
-    // generates a key the same size as the input string,
-    // shifts the input string by a random number [0, 256] % 256
+    // one-time pad cipher over a buffer, in place
+    // shifts every byte down by a key byte from rng, mod 256
     // encrypt and decrtpy must use 2 seperate random number generator functions with the same seed
+    void ethShiftDecrypt(uint8_t *data, size_t n, prng &rng)
+    {
+        uint8_t key[CRYPTO_SHIFT_BLOCK];
+        for (size_t i = 0; i < n; i += sizeof(key))
+        {
+            size_t m = std::min(n - i, sizeof(key));
+            rng.fill(key, m);
+            shiftSub(data + i, key, m);
+        }
+    }
+
+    // the shift cipher on a copy of a string
     std::string ethShiftEncrypt(std::string in, prng &rng)
     {
-        int *key = new int[in.size()];
-        for (int i = 0; i < in.size(); i++)
+        ethShiftEncrypt((uint8_t *)&in[0], in.size(), rng);
+        return in;
+    }
+
+    std::string ethShiftDecrypt(std::string in, prng &rng)
+    {
+        ethShiftDecrypt((uint8_t *)&in[0], in.size(), rng);
+        return in;
+    }
+
+    // a keystream where any byte can be reached directly, for splitting the shift
+    // cipher across threads and for decrypting a range out of the middle of a buffer
+    // byte i is byte i % 64 of the chacha20 block numbered i / 64, under a key from the seed
+    class shiftKeystream
+    {
+    public:
+
+        // the same seed gives the same keystream on every run
+        // the key and nonce come from the seed exactly as a chacha20 prng takes them, so this
+        // stream is byte for byte the one prng(seed) fills with, and a message shifted with
+        // prng(seed) can be decrypted here, in parallel or from any offset, and the other way round
+        shiftKeystream(const std::string &seed)
+        {
+            uint8_t key[40];
+            chacha::derive(seed, key, sizeof(key));
+            init(key);
+        }
+
+        // a fresh key drawn from rng, copy the keystream to hand it to the other end
+        shiftKeystream(prng &rng)
         {
-            key[i] = rng.randi(0, 256);
+            uint8_t key[40];
+            rng.fill(key, sizeof(key));
+            init(key);
         }
 
-        std::string encrypted = in;
-        for (int i = 0; i < encrypted.size(); i++)
+        // n bytes of keystream starting at byte offset
+        void generate(uint64_t offset, uint8_t *out, size_t n) const
         {
-            encrypted[i] = (encrypted[i] + key[i]) % 256;
+            uint32_t state[16];
+            uint8_t block[64];
+            std::memcpy(state, m_state, sizeof(state));
+            chacha::seek(state, offset / 64);
+
+            // a partial block to reach a block boundary, then whole blocks, then the tail
+            size_t skip = offset % 64;
+            if (skip && n > 0)
+            {
+                size_t m = std::min(n, 64 - skip);
+                chacha::blocks(state, block, 1);
+                std::memcpy(out, block + skip, m);
+                out += m;
+                n -= m;
+            }
+            chacha::blocks(state, out, n / 64);
+            if (n % 64)
+            {
+                chacha::blocks(state, block, 1);
+                std::memcpy(out + n - n % 64, block, n % 64);
+            }
+        }
+
+    private:
+
+        void init(const uint8_t key[40])
+        {
+            uint64_t nonce;
+            std::memcpy(&nonce, key + 32, sizeof(nonce));
+            chacha::init(m_state, key, nonce);
         }
 
-        delete[] key;
-        return encrypted;
+        uint32_t m_state[16];
+    };
+
+    // applies the keystream from offset on to n bytes of data in place, up or down,
+    // split into 64 byte aligned ranges over threads workers
+    void ethShiftApply(uint8_t *data, size_t n, const shiftKeystream &ks, uint64_t offset, bool decrypt, int threads)
+    {
+        auto work = [&](size_t lo, size_t hi)
+        {
+            uint8_t key[CRYPTO_SHIFT_BLOCK];
+            for (size_t i = lo; i < hi; i += sizeof(key))
+            {
+                size_t m = std::min(hi - i, sizeof(key));
+                ks.generate(offset + i, key, m);
+                if (decrypt)
+                {
+                    shiftSub(data + i, key, m);
+                } else {
+                    shiftAdd(data + i, key, m);
+                }
+            }
+        };
+
+        size_t workers = std::max(1, std::min(threads, (int)(n / CRYPTO_SHIFT_BLOCK) + 1));
+        if (workers == 1)
+        {
+            work(0, n);
+            return;
+        }
+
+        std::vector<std::thread> pool;
+        size_t chunk = ((n + workers - 1) / workers + 63) / 64 * 64;
+        for (size_t lo = 0; lo < n; lo += chunk)
+        {
+            pool.emplace_back(work, lo, std::min(n, lo + chunk));
+        }
+
+        for (std::thread &t : pool)
+        {
+            t.join();
+        }
     }
 
-    // one-time pad cipher
-    // generates a key the same size as the input string,
-    // deshifts the input string by a random number [0, 256] % 256
-    // encrypt and decrtpy must use 2 seperate random number generator functions with the same seed
-    std::string ethShiftDecrypt(std::string in, prng &rng)
+    // the shift cipher under a seekable keystream, in place
+    // offset is the position of data[0] in the whole message, so a single page
+    // can be decrypted on its own by passing where it starts
+    void ethShiftEncrypt(uint8_t *data, size_t n, const shiftKeystream &ks, uint64_t offset = 0, int threads = 1)
+    {
+        ethShiftApply(data, n, ks, offset, false, threads);
+    }
+
+    void ethShiftDecrypt(uint8_t *data, size_t n, const shiftKeystream &ks, uint64_t offset = 0, int threads = 1)
     {
-        int *key = new int[in.size()];
-        for (int i = 0; i < in.size(); i++)
+        ethShiftApply(data, n, ks, offset, true, threads);
+    }
+
+    // the shift cipher over a stream that arrives in pieces
+    // the key position carries over between update calls, and every prng backend gives
+    // the same bytes however its fills are split, so any split of the input gives the
+    // same output as one call over all of it, in constant memory
+    class ethShiftContext
+    {
+    public:
+
+        ethShiftContext(prng &rng, bool decrypt = false) : m_rng(rng), m_decrypt(decrypt), m_position(0), m_finished(false) {}
+
+        // the next n bytes of the stream from in to out, in and out may be the same buffer
+        void update(const uint8_t *in, uint8_t *out, size_t n)
+        {
+            if (m_finished)
+            {
+                throw("ERROR: update after finalize");
+            }
+
+            if (in != out && n > 0)
+            {
+                std::memmove(out, in, n);
+            }
+            if (m_decrypt)
+            {
+                ethShiftDecrypt(out, n, m_rng);
+            } else {
+                ethShiftEncrypt(out, n, m_rng);
+            }
+            m_position += n;
+        }
+
+        std::string update(const std::string &in)
         {
-            key[i] = rng.randi(0, 256);
+            std::string out(in.size(), '\0');
+            update((const uint8_t *)in.data(), (uint8_t *)&out[0], in.size());
+            return out;
         }
 
-        std::string decrypted = in;
-        for (int i = 0; i < decrypted.size(); i++)
+        // ends the stream, returning how many bytes went through it
+        // the shift cipher has no padding or tag, so nothing is left to write
+        size_t finalize()
         {
-            decrypted[i] = (decrypted[i] - key[i]) % 256;
+            m_finished = true;
+            return m_position;
         }
 
-        delete[] key;
-        return decrypted;
+        size_t position() const { return m_position; }
+
+    private:
+
+        prng &m_rng;
+        bool m_decrypt;
+        size_t m_position;
+        bool m_finished;
+    };
+
+    // pipes a whole stream through the context a fixed size buffer at a time
+    // returns the number of bytes written
+    size_t ethShiftStream(std::istream &in, std::ostream &out, ethShiftContext &ctx)
+    {
+        std::vector<char> buffer(1 << 16);
+        while (in)
+        {
+            in.read(buffer.data(), buffer.size());
+            size_t got = in.gcount();
+            if (got == 0)
+            {
+                break;
+            }
+            ctx.update((const uint8_t *)buffer.data(), (uint8_t *)buffer.data(), got);
+            if (!out.write(buffer.data(), got))
+            {
+                throw std::runtime_error("could not write stream");
+            }
+        }
+        return ctx.finalize();
     }
 
     // stores n and e
@@ -260,10 +460,17 @@ namespace crypto
     // stores n and d
     // the rsa private key
     // must be kept secret
+    // p, q, dP, dQ and qInv are the crt parameters, left at 0 when unknown
     struct rsaPrivateKey
     {
         bigint n;
         bigint d;
+
+        bigint p;
+        bigint q;
+        bigint dP;   // d mod (p - 1)
+        bigint dQ;   // d mod (q - 1)
+        bigint qInv; // q^-1 mod p
     };
 
     // rsa public key and private key combo
@@ -273,12 +480,52 @@ namespace crypto
         rsaPrivateKey privateKey;
     };
 
+    // rsa public key over a fixed modulus width
+    template <size_t Bits>
+    struct fixedRsaPublicKey
+    {
+        fixedUint<Bits> n;
+        fixedUint<Bits> e;
+
+        fixedRsaPublicKey() {}
+        explicit fixedRsaPublicKey(const rsaPublicKey &k) : n(k.n), e(k.e) {}
+    };
+
+    // rsa private key over a fixed modulus width, p and q each half of it
+    // p left at 0 means there are no crt parameters
+    template <size_t Bits>
+    struct fixedRsaPrivateKey
+    {
+        fixedUint<Bits> n;
+        fixedUint<Bits> d;
+
+        fixedUint<Bits / 2> p;
+        fixedUint<Bits / 2> q;
+        fixedUint<Bits / 2> dP;
+        fixedUint<Bits / 2> dQ;
+        fixedUint<Bits / 2> qInv;
+
+        fixedRsaPrivateKey() {}
+        explicit fixedRsaPrivateKey(const rsaPrivateKey &k)
+            : n(k.n), d(k.d), p(k.p), q(k.q), dP(k.dP), dQ(k.dQ), qInv(k.qInv) {}
+    };
+
     // generate rsa public-private key pair
-    rsaKeys genKeys(int k, prng &rng)
+    // with threads > 1, p and q are searched for at the same time,
+    // each by half of the threads
+    rsaKeys genKeys(int k, prng &rng, int threads = 1)
     {
         bigint p, q, e;
-        p = genPrime(k / 2, rng);
-        q = genPrime(k - k / 2, rng);
+        if (threads > 1)
+        {
+            prng rngP = rng.fork(), rngQ = rng.fork();
+            std::thread searchQ([&]() { q = genPrimeParallel(k - k / 2, rngQ, threads - threads / 2); });
+            p = genPrimeParallel(k / 2, rngP, threads / 2);
+            searchQ.join();
+        } else {
+            p = genPrime(k / 2, rng);
+            q = genPrime(k - k / 2, rng);
+        }
         e = 65537;
 
         bigint n = p * q;
@@ -292,81 +539,171 @@ namespace crypto
         key.privateKey.n = n;
         key.privateKey.d = d;
 
+        // keep the factors for crt decryption
+        key.privateKey.p = p;
+        key.privateKey.q = q;
+        key.privateKey.dP = d % (p - 1);
+        key.privateKey.dQ = d % (q - 1);
+        key.privateKey.qInv = secureInverse(q, p);
+
         return key;
     }
 
     // encrypts an integer ussing rsa pub key
-    bigint encrypt(rsaPublicKey k, bigint m)
+    // the montgomery context for k.n is cached per thread
+    bigint encrypt(const rsaPublicKey &k, const bigint &m)
     {
-        return power(m, k.e, k.n);
+        return montgomeryCache(k.n).modexp(m, k.e);
     }
 
-    // decrypts an integer using rsa private key
-    bigint decrypt(rsaPrivateKey k, bigint c)
+    // garner recombination of m1 = m mod p and m2 = m mod q into m mod n
+    bigint crtCombine(const rsaPrivateKey &k, const bigint &m1, const bigint &m2)
+    {
+        // h = qInv (m1 - m2) mod p, kept non negative
+        bigint h = m1 + k.p;
+        h -= m2 % k.p;
+        h = (h * k.qInv) % k.p;
+
+        return m2 + h * k.q;
+    }
+
+    // decrypts an integer using the chinese remainder theorem
+    // two half size exponentiations mod p and q, recombined with garner's formula
+    // the contexts for p and q are built here and dropped on return, never cached,
+    // so the secret factors do not outlive the call in any thread
+    // not constant time: the window lookups and the final montgomery subtraction
+    // depend on the secret exponents and intermediate values
+    bigint decryptCRT(const rsaPrivateKey &k, const bigint &c)
     {
-        return power(c, k.d, k.n);
+        bigint m1 = montgomeryContext(k.p).modexp(c, k.dP);
+        bigint m2 = montgomeryContext(k.q).modexp(c, k.dQ);
+
+        return crtCombine(k, m1, m2);
     }
 
-    // miller rabin faster (?)
-    bool millerRabin2(bigint n, int k, prng &rng)
+    // decrypts an integer using rsa private key
+    // uses crt when the key carries its factors
+    // the montgomery context for k.n is cached per thread
+    bigint decrypt(const rsaPrivateKey &k, const bigint &c)
     {
-        if (n == 2)
+        if (!null(k.p))
         {
-            return true;
+            return decryptCRT(k, c);
         }
 
-        if (n % 2 == 0)
+        return montgomeryCache(k.n).modexp(c, k.d);
+    }
+
+    // encrypts a fixed width integer, entirely on the stack
+    template <size_t Bits>
+    fixedUint<Bits> encrypt(const fixedRsaPublicKey<Bits> &k, const fixedUint<Bits> &m)
+    {
+        return fixedMontgomeryContext<Bits>(k.n).modexp(m, k.e);
+    }
+
+    // decrypts a fixed width integer, with crt over the half width factors when present
+    template <size_t Bits>
+    fixedUint<Bits> decrypt(const fixedRsaPrivateKey<Bits> &k, const fixedUint<Bits> &c)
+    {
+        if (k.p.isZero())
         {
-            return false;
+            return fixedMontgomeryContext<Bits>(k.n).modexp(c, k.d);
         }
 
-        // find d
-        bigint r = 0;
-        bigint d;
-        do
+        fixedMontgomeryContext<Bits / 2> P(k.p), Q(k.q);
+        fixedUint<Bits / 2> m1 = P.modexp(c, k.dP), m2 = Q.modexp(c, k.dQ), h;
+
+        // garner, h = qInv (m1 - m2) mod p, taking the difference in montgomery
+        // form so m2 does not need reducing mod p first
+        P.subMod(h, P.toMont(m1), P.toMont(m2));
+        h = P.mul(h, k.qInv);
+
+        return mulWide(h, k.q) + fixedUint<Bits>(m2);
+    }
+
+    // decrypts count ciphertexts under one private key into out, in input order
+    // the reduction contexts and exponent recoding are built once for the batch,
+    // and with threads > 1 the batch is split across that many worker threads
+    void decryptBatch(const rsaPrivateKey &k, const bigint *c, size_t count, bigint *out, int threads = 1)
+    {
+        if (count == 0)
         {
-            r++;
-            d = (n - 1) / (bigint(2) ^ r);
-        } while (n != (bigint(2) ^ r) * d + 1);
+            return;
+        }
 
-        for (int i = 0; i < k; i++)
+        bool crt = !null(k.p);
+        std::unique_ptr<montgomeryContext> ctxN, ctxP, ctxQ;
+        if (crt)
         {
-            bigint a = rng.randbi(2, n - 2);
-            bigint x = power(a, d, n);
+            ctxP.reset(new montgomeryContext(k.p));
+            ctxQ.reset(new montgomeryContext(k.q));
+        } else {
+            ctxN.reset(new montgomeryContext(k.n));
+        }
 
-            if (x == 1 || x == n - 1)
+        auto work = [&](size_t lo, size_t hi)
+        {
+            if (!crt)
             {
-                continue;
+                ctxN->modexpBatch(c + lo, hi - lo, k.d, out + lo);
+                return;
             }
 
-            bool cont = false;
-            for (bigint j = 0; j < r - 1; j++)
+            std::unique_ptr<bigint[]> m2(new bigint[hi - lo]);
+            ctxP->modexpBatch(c + lo, hi - lo, k.dP, out + lo);
+            ctxQ->modexpBatch(c + lo, hi - lo, k.dQ, m2.get());
+            for (size_t i = lo; i < hi; i++)
             {
-                x = power(x, 2, n);
-                if (x == n - 1)
-                {
-                    cont = true;
-                    break;
-                }
+                out[i] = crtCombine(k, out[i], m2[i - lo]);
             }
+        };
 
-            if (cont)
-            {
-                continue;
-            }
+        size_t workers = std::max(1, std::min(threads, (int)count));
+        if (workers == 1)
+        {
+            work(0, count);
+            return;
+        }
 
-            return false;
+        std::vector<std::thread> pool;
+        size_t chunk = (count + workers - 1) / workers;
+        for (size_t lo = 0; lo < count; lo += chunk)
+        {
+            pool.emplace_back(work, lo, std::min(count, lo + chunk));
         }
 
-        return true;
+        for (std::thread &t : pool)
+        {
+            t.join();
+        }
+    }
+
+    // signs an integer using rsa private key
+    // the same private key operation as decrypt, so it takes the crt path too
+    bigint sign(const rsaPrivateKey &k, const bigint &m)
+    {
+        return decrypt(k, m);
     }
 
     // encryption using pkcs v1.5
     std::string pkcs1_5(rsaPublicKey k, std::string hex, prng &rng)
     {
-        int k_abs = bigintToHex(k.n).size() / 2;
+        int k_abs = byteLength(k.n);
         int d = hex.size() / 2;
-        std::string PK = bigintToHex(rng.randbi((k_abs - d - 3) * 8));
+
+        // the padding string is random nonzero bytes, zeros are redrawn
+        std::vector<uint8_t> ps(std::max(k_abs - d - 3, 0));
+        rng.fill(ps.data(), ps.size());
+        for (uint8_t &b : ps)
+        {
+            while (b == 0)
+            {
+                rng.fill(&b, 1);
+            }
+        }
+
+        std::string PK(2 * ps.size(), '0');
+        hexEncode(ps.data(), ps.size(), &PK[0]);
         std::string EB = std::string("00") + "02" + PK + "00" + hex;
 
         return EB;
@@ -389,97 +726,406 @@ namespace crypto
         return m;
     }
 
-    // save rsa keys to filepath
-    void saveKeys(rsaKeys &keys, std::string filename)
+    // binary key files
+    // "RSAK", a version byte, a kind byte, a 16 bit field count, then every
+    // field as a 32 bit limb count followed by its limbs, all little endian
+    // the fields are n, e for a public key, n, d, p, q, dP, dQ, qInv for a
+    // private key, and the public fields then the private ones for a key pair
+    namespace keyFormat
     {
-        std::ofstream keyFile(filename, std::ios::out | std::ios::binary);
+        const char magic[4] = {'R', 'S', 'A', 'K'};
+        const uint8_t version = 1;
 
-        if (!keyFile) 
+        enum kind : uint8_t
         {
-            throw std::runtime_error("could not open file");
+            publicKey = 1,
+            privateKey = 2,
+            keyPair = 3
+        };
+
+        // appends v to out as a little endian integer of the given width
+        void putInt(std::string &out, uint64_t v, int bytes)
+        {
+            for (int i = 0; i < bytes; i++)
+            {
+                out += (char)(v >> (8 * i));
+            }
+        }
+
+        void putField(std::string &out, const bigint &x)
+        {
+            size_t limbCount = (byteLength(x) + 7) / 8;
+            putInt(out, limbCount, 4);
+            size_t at = out.size();
+            out.resize(at + 8 * limbCount);
+            toBytes(x, (uint8_t *)&out[at], 8 * limbCount, byteOrder::little);
         }
 
-        keyFile.write((char*)&keys, sizeof(rsaKeys));
-        keyFile.close();
+        std::string header(kind k, uint16_t fields)
+        {
+            std::string out(magic, 4);
+            out += (char)version;
+            out += (char)k;
+            putInt(out, fields, 2);
+            return out;
+        }
+
+        // reads the fields back out of a buffer, checking every length against its end
+        class reader
+        {
+        public:
+
+            reader(const uint8_t *data, size_t size, kind k, uint16_t fields) : m_at(data), m_end(data + size)
+            {
+                if (size < 8 || std::memcmp(data, magic, 4) != 0)
+                {
+                    throw std::runtime_error("not a key file");
+                }
+                if (data[4] != version)
+                {
+                    throw std::runtime_error("unsupported key file version");
+                }
+                if (data[5] != k || getInt(data + 6, 2) != fields)
+                {
+                    throw std::runtime_error("key file holds a different kind of key");
+                }
+                m_at += 8;
+            }
+
+            bigint next()
+            {
+                if (m_end - m_at < 4)
+                {
+                    throw std::runtime_error("truncated key file");
+                }
+                size_t limbCount = getInt(m_at, 4);
+                m_at += 4;
+                if ((size_t)(m_end - m_at) / 8 < limbCount)
+                {
+                    throw std::runtime_error("truncated key file");
+                }
+                bigint x = fromBytes(m_at, 8 * limbCount, byteOrder::little);
+                m_at += 8 * limbCount;
+                return x;
+            }
+
+        private:
+
+            static uint64_t getInt(const uint8_t *p, int bytes)
+            {
+                uint64_t v = 0;
+                for (int i = 0; i < bytes; i++)
+                {
+                    v |= (uint64_t)p[i] << (8 * i);
+                }
+                return v;
+            }
+
+            const uint8_t *m_at;
+            const uint8_t *m_end;
+        };
+
+        // a whole file mapped read only, so parsing reads straight from the page cache
+        class mappedFile
+        {
+        public:
+
+            explicit mappedFile(const std::string &filename)
+            {
+                m_fd = open(filename.c_str(), O_RDONLY);
+                if (m_fd < 0)
+                {
+                    throw std::runtime_error("file not found error");
+                }
+
+                struct stat st;
+                if (fstat(m_fd, &st) < 0 || st.st_size == 0)
+                {
+                    close(m_fd);
+                    throw std::runtime_error("not a key file");
+                }
+
+                m_size = st.st_size;
+                m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+                if (m_data == MAP_FAILED)
+                {
+                    close(m_fd);
+                    throw std::runtime_error("could not map file");
+                }
+            }
+
+            mappedFile(const mappedFile &) = delete;
+            mappedFile &operator=(const mappedFile &) = delete;
+
+            ~mappedFile()
+            {
+                munmap(m_data, m_size);
+                close(m_fd);
+            }
+
+            const uint8_t *data() const { return (const uint8_t *)m_data; }
+            size_t size() const { return m_size; }
+
+        private:
+
+            int m_fd;
+            void *m_data;
+            size_t m_size;
+        };
+
+        void writeFile(const std::string &filename, const std::string &bytes)
+        {
+            std::ofstream keyFile(filename, std::ios::out | std::ios::binary);
+
+            if (!keyFile)
+            {
+                throw std::runtime_error("could not open file");
+            }
+
+            // a full disk or io error must not leave a truncated key behind looking saved
+            keyFile.write(bytes.data(), bytes.size());
+            if (!keyFile)
+            {
+                throw std::runtime_error("could not write file");
+            }
+
+            keyFile.close();
+            if (!keyFile)
+            {
+                throw std::runtime_error("could not write file");
+            }
+        }
     }
 
-    // save rsa private key to filepath
-    void savePrivateKey(rsaPrivateKey &pkey, std::string filename)
+    std::string serializePublicKey(const rsaPublicKey &k)
     {
-        std::ofstream keyFile(filename, std::ios::out | std::ios::binary);
+        std::string out = keyFormat::header(keyFormat::publicKey, 2);
+        keyFormat::putField(out, k.n);
+        keyFormat::putField(out, k.e);
+        return out;
+    }
 
-        if (!keyFile) 
+    // the private fields alone, shared by the private key and key pair formats
+    void serializePrivateFields(std::string &out, const rsaPrivateKey &k)
+    {
+        for (const bigint *x : {&k.n, &k.d, &k.p, &k.q, &k.dP, &k.dQ, &k.qInv})
         {
-            throw std::runtime_error("could not open file");
+            keyFormat::putField(out, *x);
         }
+    }
+
+    std::string serializePrivateKey(const rsaPrivateKey &k)
+    {
+        std::string out = keyFormat::header(keyFormat::privateKey, 7);
+        serializePrivateFields(out, k);
+        return out;
+    }
 
-        keyFile.write((char*)&pkey, sizeof(rsaPrivateKey));
-        keyFile.close();
+    std::string serializeKeys(const rsaKeys &k)
+    {
+        std::string out = keyFormat::header(keyFormat::keyPair, 9);
+        keyFormat::putField(out, k.publicKey.n);
+        keyFormat::putField(out, k.publicKey.e);
+        serializePrivateFields(out, k.privateKey);
+        return out;
     }
 
-    // save rsa public key to filepath
-    void savePublicKey(rsaPublicKey &pkey, std::string filename)
+    rsaPublicKey parsePublicKey(const uint8_t *data, size_t size)
     {
-        std::ofstream keyFile(filename, std::ios::out | std::ios::binary);
+        keyFormat::reader in(data, size, keyFormat::publicKey, 2);
+        rsaPublicKey k;
+        k.n = in.next();
+        k.e = in.next();
+        return k;
+    }
 
-        if (!keyFile) 
+    void parsePrivateFields(keyFormat::reader &in, rsaPrivateKey &k)
+    {
+        for (bigint *x : {&k.n, &k.d, &k.p, &k.q, &k.dP, &k.dQ, &k.qInv})
         {
-            throw std::runtime_error("could not open file");
+            *x = in.next();
         }
+    }
 
-        keyFile.write((char*)&pkey, sizeof(rsaPublicKey));
-        keyFile.close();
+    rsaPrivateKey parsePrivateKey(const uint8_t *data, size_t size)
+    {
+        keyFormat::reader in(data, size, keyFormat::privateKey, 7);
+        rsaPrivateKey k;
+        parsePrivateFields(in, k);
+        return k;
     }
 
-    // load rsa keys from file
-    rsaKeys loadKeys(std::string filename)
+    rsaKeys parseKeys(const uint8_t *data, size_t size)
     {
-        std::ifstream keyFile(filename, std::ios::out | std::ios::binary);
-        if (!keyFile)
-        {
-            throw std::runtime_error("file not found error");
-        }
+        keyFormat::reader in(data, size, keyFormat::keyPair, 9);
+        rsaKeys k;
+        k.publicKey.n = in.next();
+        k.publicKey.e = in.next();
+        parsePrivateFields(in, k.privateKey);
+        return k;
+    }
+
+    // save rsa keys to filepath
+    void saveKeys(const rsaKeys &keys, const std::string &filename)
+    {
+        keyFormat::writeFile(filename, serializeKeys(keys));
+    }
 
-        rsaKeys keys;
-        keyFile.read((char*)&keys, sizeof(rsaKeys));
+    // save rsa private key to filepath
+    void savePrivateKey(const rsaPrivateKey &pkey, const std::string &filename)
+    {
+        keyFormat::writeFile(filename, serializePrivateKey(pkey));
+    }
 
-        keyFile.close();
+    // save rsa public key to filepath
+    void savePublicKey(const rsaPublicKey &pkey, const std::string &filename)
+    {
+        keyFormat::writeFile(filename, serializePublicKey(pkey));
+    }
 
-        return keys;
+    // load rsa keys from file
+    rsaKeys loadKeys(const std::string &filename)
+    {
+        keyFormat::mappedFile file(filename);
+        return parseKeys(file.data(), file.size());
     }
 
     // load rsa private key from file
-    rsaPrivateKey loadPrivateKey(std::string filename)
+    rsaPrivateKey loadPrivateKey(const std::string &filename)
+    {
+        keyFormat::mappedFile file(filename);
+        return parsePrivateKey(file.data(), file.size());
+    }
+
+    // load rsa public key from file
+    rsaPublicKey loadPublicKey(const std::string &filename)
+    {
+        keyFormat::mappedFile file(filename);
+        return parsePublicKey(file.data(), file.size());
+    }
+
+    // der and pem export in the pkcs #1 layouts, for other tools to read
+    namespace der
     {
-        std::ifstream keyFile(filename, std::ios::out | std::ios::binary);
-        if (!keyFile)
+        // a tag and definite length
+        void putHeader(std::string &out, uint8_t tag, size_t length)
         {
-            throw std::runtime_error("file not found error");
+            out += (char)tag;
+            if (length < 128)
+            {
+                out += (char)length;
+                return;
+            }
+
+            int bytes = 0;
+            for (size_t l = length; l; l >>= 8)
+            {
+                bytes++;
+            }
+            out += (char)(0x80 | bytes);
+            while (bytes--)
+            {
+                out += (char)(length >> (8 * bytes));
+            }
         }
 
-        rsaPrivateKey key;
-        keyFile.read((char*)&key, sizeof(rsaPrivateKey));
+        // a non negative INTEGER, with a leading zero byte when the top bit is set
+        void putInteger(std::string &out, const bigint &x)
+        {
+            size_t n = byteLength(x);
+            bool pad = n == 0 || testBit(x, 8 * n - 1);
+            putHeader(out, 0x02, n + pad);
+            if (pad)
+            {
+                out += '\0';
+            }
+            size_t at = out.size();
+            out.resize(at + n);
+            toBytes(x, (uint8_t *)&out[at], n);
+        }
 
-        keyFile.close();
+        std::string sequence(const std::string &body)
+        {
+            std::string out;
+            putHeader(out, 0x30, body.size());
+            return out + body;
+        }
 
-        return key;
+        std::string base64(const std::string &in)
+        {
+            static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            std::string out;
+            out.reserve((in.size() + 2) / 3 * 4);
+            for (size_t i = 0; i < in.size(); i += 3)
+            {
+                uint32_t v = (uint8_t)in[i] << 16;
+                if (i + 1 < in.size())
+                {
+                    v |= (uint8_t)in[i + 1] << 8;
+                }
+                if (i + 2 < in.size())
+                {
+                    v |= (uint8_t)in[i + 2];
+                }
+
+                out += digits[v >> 18 & 63];
+                out += digits[v >> 12 & 63];
+                out += i + 1 < in.size() ? digits[v >> 6 & 63] : '=';
+                out += i + 2 < in.size() ? digits[v & 63] : '=';
+            }
+            return out;
+        }
+
+        // base64 in 64 character lines between the begin and end markers
+        std::string pem(const std::string &label, const std::string &derBytes)
+        {
+            std::string body = base64(derBytes), out = "-----BEGIN " + label + "-----\n";
+            for (size_t i = 0; i < body.size(); i += 64)
+            {
+                out += body.substr(i, 64) + "\n";
+            }
+            return out + "-----END " + label + "-----\n";
+        }
     }
 
-    // load rsa public key from file
-    rsaPublicKey loadPublicKey(std::string filename)
+    // RSAPublicKey ::= SEQUENCE { n, e }
+    std::string toDer(const rsaPublicKey &k)
     {
-        std::ifstream keyFile(filename, std::ios::out | std::ios::binary);
-        if (!keyFile)
+        std::string body;
+        der::putInteger(body, k.n);
+        der::putInteger(body, k.e);
+        return der::sequence(body);
+    }
+
+    // RSAPrivateKey ::= SEQUENCE { 0, n, e, d, p, q, dP, dQ, qInv }
+    // needs the crt parameters, which keys from genKeys always have
+    std::string toDer(const rsaKeys &k)
+    {
+        const rsaPrivateKey &p = k.privateKey;
+        if (null(p.p))
         {
-            throw std::runtime_error("file not found error");
+            throw std::runtime_error("der export needs the crt parameters");
         }
 
-        rsaPublicKey key;
-        keyFile.read((char*)&key, sizeof(rsaPublicKey));
+        std::string body;
+        der::putInteger(body, 0);
+        der::putInteger(body, k.publicKey.n);
+        der::putInteger(body, k.publicKey.e);
+        for (const bigint *x : {&p.d, &p.p, &p.q, &p.dP, &p.dQ, &p.qInv})
+        {
+            der::putInteger(body, *x);
+        }
+        return der::sequence(body);
+    }
 
-        keyFile.close();
+    std::string toPem(const rsaPublicKey &k)
+    {
+        return der::pem("RSA PUBLIC KEY", toDer(k));
+    }
 
-        return key;
+    std::string toPem(const rsaKeys &k)
+    {
+        return der::pem("RSA PRIVATE KEY", toDer(k));
     }
 }
 
@@ -0,0 +1,214 @@
+#ifndef fixed_hpp
+#define fixed_hpp
+
+#include <array>
+#include <cstdint>
+
+#include <limbs.hpp>
+#include <types.hpp>
+
+namespace crypto
+{
+    // unsigned integer of a fixed Bits width, held in a std::array of limbs
+    // meant for values whose size is known up front, such as rsa moduli,
+    // so nothing allocates and every limb loop has a compile time length
+    // arithmetic wraps modulo 2^Bits like the built in unsigned types
+    template <size_t Bits>
+    class fixedUint
+    {
+        static_assert(Bits > 0 && Bits % 64 == 0, "fixedUint width must be a whole number of limbs");
+
+    public:
+
+        // number of limbs
+        static constexpr size_t size = Bits / 64;
+
+        constexpr fixedUint(unsigned long long n = 0) : m_limbs{}
+        {
+            m_limbs[0] = n;
+        }
+
+        // zero extends or truncates another width
+        template <size_t B>
+        constexpr explicit fixedUint(const fixedUint<B> &x) : m_limbs{}
+        {
+            for (size_t i = 0; i < size && i < fixedUint<B>::size; i++)
+            {
+                m_limbs[i] = x[i];
+            }
+        }
+
+        // throws if x needs more than Bits bits
+        explicit fixedUint(const bigint &x) : m_limbs{}
+        {
+            if (crypto::bitLength(x) > (int)Bits)
+            {
+                throw("Arithmetic Error: Value does not fit the fixed width");
+            }
+            for (int i = 0; i < crypto::length(x); i++)
+            {
+                m_limbs[i] = x[i];
+            }
+        }
+
+        explicit operator bigint() const
+        {
+            bigint r;
+            r.limbs.assign(m_limbs.begin(), m_limbs.end());
+            r.trim();
+            return r;
+        }
+
+        constexpr limb_t operator[](size_t i) const { return m_limbs[i]; }
+        constexpr limb_t &operator[](size_t i) { return m_limbs[i]; }
+        constexpr const limb_t *data() const { return m_limbs.data(); }
+        constexpr limb_t *data() { return m_limbs.data(); }
+
+        constexpr bool isZero() const
+        {
+            limb_t any = 0;
+            limbs::unroll<size>([&](size_t i) { any |= m_limbs[i]; });
+            return !any;
+        }
+
+        constexpr int bitLength() const
+        {
+            for (size_t i = size; i-- > 0;)
+            {
+                if (m_limbs[i])
+                {
+                    return 64 * i + 64 - __builtin_clzll(m_limbs[i]);
+                }
+            }
+            return 0;
+        }
+
+        constexpr bool testBit(size_t i) const
+        {
+            return (m_limbs[i / 64] >> (i % 64)) & 1;
+        }
+
+        // adds x, returns the carry out
+        constexpr limb_t addCarry(const fixedUint &x)
+        {
+            limb_t c = 0;
+            limbs::unroll<size>([&](size_t i)
+            {
+                dlimb_t s = (dlimb_t)m_limbs[i] + x.m_limbs[i] + c;
+                m_limbs[i] = (limb_t)s;
+                c = (limb_t)(s >> 64);
+            });
+            return c;
+        }
+
+        // subtracts x, returns the borrow out
+        constexpr limb_t subBorrow(const fixedUint &x)
+        {
+            limb_t c = 0;
+            limbs::unroll<size>([&](size_t i)
+            {
+                dlimb_t d = (dlimb_t)m_limbs[i] - x.m_limbs[i] - c;
+                m_limbs[i] = (limb_t)d;
+                c = (limb_t)(d >> 64) & 1;
+            });
+            return c;
+        }
+
+        // shifts left one bit, returns the bit shifted out
+        constexpr limb_t shiftLeft1()
+        {
+            limb_t c = 0;
+            limbs::unroll<size>([&](size_t i)
+            {
+                limb_t next = m_limbs[i] >> 63;
+                m_limbs[i] = (m_limbs[i] << 1) | c;
+                c = next;
+            });
+            return c;
+        }
+
+        constexpr fixedUint &operator+=(const fixedUint &x)
+        {
+            addCarry(x);
+            return *this;
+        }
+
+        constexpr fixedUint &operator-=(const fixedUint &x)
+        {
+            subBorrow(x);
+            return *this;
+        }
+
+        // low Bits of the product
+        constexpr fixedUint &operator*=(const fixedUint &x)
+        {
+            *this = fixedUint(mulWide(*this, x));
+            return *this;
+        }
+
+        friend constexpr fixedUint operator+(fixedUint a, const fixedUint &b)
+        {
+            return a += b;
+        }
+
+        friend constexpr fixedUint operator-(fixedUint a, const fixedUint &b)
+        {
+            return a -= b;
+        }
+
+        friend constexpr fixedUint operator*(fixedUint a, const fixedUint &b)
+        {
+            return a *= b;
+        }
+
+        // the full 2 Bits product
+        friend constexpr fixedUint<2 * Bits> mulWide(const fixedUint &a, const fixedUint &b)
+        {
+            fixedUint<2 * Bits> r;
+            for (size_t i = 0; i < size; i++)
+            {
+                limb_t c = 0, ai = a.m_limbs[i];
+                limbs::unroll<size>([&](size_t j)
+                {
+                    dlimb_t p = (dlimb_t)ai * b.m_limbs[j] + r[i + j] + c;
+                    r[i + j] = (limb_t)p;
+                    c = (limb_t)(p >> 64);
+                });
+                r[i + size] = c;
+            }
+            return r;
+        }
+
+        // -1, 0 or 1, reading every limb regardless of where they differ
+        friend constexpr int compare(const fixedUint &a, const fixedUint &b)
+        {
+            int r = 0;
+            limbs::unroll<size>([&](size_t i)
+            {
+                if (a.m_limbs[i] != b.m_limbs[i])
+                {
+                    r = a.m_limbs[i] < b.m_limbs[i] ? -1 : 1;
+                }
+            });
+            return r;
+        }
+
+        friend constexpr bool operator==(const fixedUint &a, const fixedUint &b) { return compare(a, b) == 0; }
+        friend constexpr bool operator!=(const fixedUint &a, const fixedUint &b) { return compare(a, b) != 0; }
+        friend constexpr bool operator<(const fixedUint &a, const fixedUint &b) { return compare(a, b) < 0; }
+        friend constexpr bool operator<=(const fixedUint &a, const fixedUint &b) { return compare(a, b) <= 0; }
+        friend constexpr bool operator>(const fixedUint &a, const fixedUint &b) { return compare(a, b) > 0; }
+        friend constexpr bool operator>=(const fixedUint &a, const fixedUint &b) { return compare(a, b) >= 0; }
+
+        friend std::ostream &operator<<(std::ostream &out, const fixedUint &a)
+        {
+            return out << bigint(a);
+        }
+
+    private:
+
+        std::array<limb_t, size> m_limbs;
+    };
+}
+
+#endif
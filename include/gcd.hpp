@@ -0,0 +1,338 @@
+#ifndef gcd_hpp
+#define gcd_hpp
+
+#include <vector>
+#include <cstdint>
+
+#include <types.hpp>
+#include <signed.hpp>
+
+namespace crypto
+{
+    // gcd and bezout coefficients, g = x a + y b
+    struct extendedGcdResult
+    {
+        bigint g;
+        signedBigint x;
+        signedBigint y;
+    };
+
+    // stein's binary gcd on machine words
+    uint64_t binaryGcd(uint64_t a, uint64_t b)
+    {
+        if (!a || !b)
+        {
+            return a | b;
+        }
+
+        int shift = __builtin_ctzll(a | b);
+        a >>= __builtin_ctzll(a);
+        do
+        {
+            b >>= __builtin_ctzll(b);
+            if (a > b)
+            {
+                std::swap(a, b);
+            }
+            b -= a;
+        } while (b);
+
+        return a << shift;
+    }
+
+    // iterative gcd engine
+    // single limb operands use stein's binary gcd, larger ones use lehmer's
+    // algorithm on 62 bit leading approximations, falling back to one long
+    // division when the leading bits cannot predict a quotient
+    // the working buffers are kept between calls, so reusing an engine does not allocate
+    class gcdEngine
+    {
+    public:
+
+        bigint gcd(const bigint &a, const bigint &b)
+        {
+            load(a, b);
+            run(false);
+            return store(m_u, m_un);
+        }
+
+        // gcd of a and b together with bezout coefficients
+        extendedGcdResult extendedGcd(const bigint &a, const bigint &b)
+        {
+            load(a, b);
+            run(true);
+
+            extendedGcdResult res;
+            res.g = store(m_u, m_un);
+            res.x = signedBigint(store(m_x0, m_x0n), m_steps & 1);
+
+            // y = (g - x a) / b, exact
+            if (!null(b))
+            {
+                signedBigint r = signedBigint(res.g) - res.x * signedBigint(a);
+                res.y = signedBigint(r.magnitude() / b, r.negative());
+            }
+
+            return res;
+        }
+
+    private:
+
+        // u = a, v = b, cofactors of a: x0 = 1, x1 = 0
+        void load(const bigint &a, const bigint &b)
+        {
+            size_t n = std::max(a.limbs.size(), b.limbs.size()) + 2;
+            for (std::vector<limb_t> *buf : { &m_u, &m_v, &m_nu, &m_nv, &m_t1, &m_t2, &m_x0, &m_x1, &m_x2 })
+            {
+                if (buf->size() < 2 * n)
+                {
+                    buf->resize(2 * n);
+                }
+            }
+            if (m_q.size() < n)
+            {
+                m_q.resize(n);
+            }
+
+            std::copy(a.limbs.begin(), a.limbs.end(), m_u.begin());
+            std::copy(b.limbs.begin(), b.limbs.end(), m_v.begin());
+            m_un = normalized(m_u.data(), a.limbs.size());
+            m_vn = normalized(m_v.data(), b.limbs.size());
+
+            m_x0[0] = 1;
+            m_x0n = 1;
+            m_x1n = 0;
+            m_steps = 0;
+        }
+
+        bigint store(const std::vector<limb_t> &buf, size_t n) const
+        {
+            bigint r;
+            if (n)
+            {
+                r.limbs.assign(buf.begin(), buf.begin() + n);
+            }
+            return r;
+        }
+
+        static size_t normalized(const limb_t *p, size_t n)
+        {
+            while (n && !p[n - 1])
+            {
+                n--;
+            }
+            return n;
+        }
+
+        // the u = (-1)^steps x0 a (mod b) and v = (-1)^(steps + 1) x1 a (mod b)
+        // invariants hold after every step, so only magnitudes are stored
+        void run(bool extended)
+        {
+            while (m_vn)
+            {
+                if (!extended && m_un <= 1 && m_vn <= 1)
+                {
+                    m_u[0] = binaryGcd(m_u[0], m_v[0]);
+                    m_un = 1;
+                    m_vn = 0;
+                    break;
+                }
+
+                if (!lehmerStep(extended))
+                {
+                    divisionStep(extended);
+                }
+            }
+        }
+
+        // (u, v) = (v, u mod v), (x0, x1) = (x1, x0 + q x1)
+        void divisionStep(bool extended)
+        {
+            size_t qn = 0;
+            if (m_un >= m_vn)
+            {
+                qn = m_un - m_vn + 1;
+                if (m_vn == 1)
+                {
+                    m_nv[0] = limbs::divrem1(m_q.data(), m_u.data(), m_un, m_v[0]);
+                } else {
+                    size_t need = limbs::divremScratch(m_un, m_vn);
+                    if (m_scratch.size() < need)
+                    {
+                        m_scratch.resize(need);
+                    }
+                    limbs::divrem(m_q.data(), m_nv.data(), m_u.data(), m_un, m_v.data(), m_vn, m_scratch.data());
+                }
+                qn = normalized(m_q.data(), qn);
+            } else {
+                // q = 0, the remainder is u itself
+                std::copy(m_u.begin(), m_u.begin() + m_un, m_nv.begin());
+            }
+
+            size_t rn = normalized(m_nv.data(), std::min(m_un, m_vn));
+            std::swap(m_u, m_v);
+            std::swap(m_v, m_nv);
+            m_un = m_vn;
+            m_vn = rn;
+
+            if (extended)
+            {
+                // x2 = x0 + q x1
+                size_t xn = 0;
+                if (qn && m_x1n)
+                {
+                    size_t need = limbs::mulScratch(qn, m_x1n);
+                    if (m_scratch.size() < need)
+                    {
+                        m_scratch.resize(need);
+                    }
+                    limbs::mul(m_x2.data(), m_q.data(), qn, m_x1.data(), m_x1n, m_scratch.data());
+                    xn = qn + m_x1n;
+                }
+                xn = addInto(m_x2, xn, m_x0, m_x0n);
+
+                std::swap(m_x0, m_x1);
+                std::swap(m_x1, m_x2);
+                m_x0n = m_x1n;
+                m_x1n = xn;
+            }
+            m_steps++;
+        }
+
+        // r = r + x where r holds rn limbs, returns the new size
+        static size_t addInto(std::vector<limb_t> &r, size_t rn, const std::vector<limb_t> &x, size_t xn)
+        {
+            size_t n = std::max(rn, xn);
+            std::fill(r.begin() + rn, r.begin() + n + 1, 0);
+            r[n] = limbs::add(r.data(), r.data(), n, x.data(), xn);
+            return normalized(r.data(), n + 1);
+        }
+
+        // bits [shift, shift + 62) of p
+        static uint64_t leading(const std::vector<limb_t> &p, size_t n, size_t shift)
+        {
+            size_t i = shift / 64;
+            dlimb_t w = i < n ? p[i] : 0;
+            if (i + 1 < n)
+            {
+                w |= (dlimb_t)p[i + 1] << 64;
+            }
+            return (uint64_t)(w >> (shift % 64)) & (((uint64_t)1 << 62) - 1);
+        }
+
+        // r = |s| x - |t| y if s > 0, else |t| y - |s| x, the sign pattern
+        // of lehmer's matrix guarantees the result is not negative
+        // x holds xn limbs, y holds yn <= xn limbs, returns the size of r
+        size_t combine(std::vector<limb_t> &r, int64_t s, int64_t t,
+                       const std::vector<limb_t> &x, size_t xn, const std::vector<limb_t> &y, size_t yn)
+        {
+            limb_t as = s < 0 ? -(limb_t)s : s, at = t < 0 ? -(limb_t)t : t;
+            m_t1[xn] = limbs::mul1(m_t1.data(), x.data(), xn, as);
+            m_t2[yn] = limbs::mul1(m_t2.data(), y.data(), yn, at);
+            std::fill(m_t2.begin() + yn + 1, m_t2.begin() + xn + 1, 0);
+
+            if (s > 0)
+            {
+                limbs::subN(r.data(), m_t1.data(), m_t2.data(), xn + 1);
+            } else {
+                limbs::subN(r.data(), m_t2.data(), m_t1.data(), xn + 1);
+            }
+            return normalized(r.data(), xn + 1);
+        }
+
+        // r = |s| x + |t| y, returns the size of r
+        static size_t combineCofactor(std::vector<limb_t> &r, int64_t s, int64_t t,
+                                      std::vector<limb_t> &x, size_t xn, std::vector<limb_t> &y, size_t yn)
+        {
+            limb_t as = s < 0 ? -(limb_t)s : s, at = t < 0 ? -(limb_t)t : t;
+            size_t n = std::max(xn, yn);
+            std::fill(x.begin() + xn, x.begin() + n, 0);
+            std::fill(y.begin() + yn, y.begin() + n, 0);
+
+            limb_t c = limbs::mul1(r.data(), x.data(), n, as);
+            dlimb_t top = (dlimb_t)c + limbs::addmul1(r.data(), y.data(), n, at);
+            r[n] = (limb_t)top;
+            r[n + 1] = (limb_t)(top >> 64);
+            return normalized(r.data(), n + 2);
+        }
+
+        // knuth's algorithm l, simulating euclid on the leading bits of u and v
+        // and applying the accumulated 2x2 matrix in one multi limb pass
+        bool lehmerStep(bool extended)
+        {
+            if (m_un < 2 || m_un < m_vn || (m_un == m_vn && limbs::cmpN(m_u.data(), m_v.data(), m_un) < 0))
+            {
+                return false;
+            }
+
+            size_t bits = 64 * (m_un - 1) + (64 - __builtin_clzll(m_u[m_un - 1]));
+            size_t shift = bits - 62;
+            __int128 x = leading(m_u, m_un, shift), y = leading(m_v, m_vn, shift);
+            __int128 A = 1, B = 0, C = 0, D = 1;
+            int steps = 0;
+
+            while (y + C != 0 && y + D != 0)
+            {
+                __int128 q = (x + A) / (y + C);
+                if (q != (x + B) / (y + D))
+                {
+                    break;
+                }
+
+                __int128 t = A - q * C;
+                A = C;
+                C = t;
+                t = B - q * D;
+                B = D;
+                D = t;
+                t = x - q * y;
+                x = y;
+                y = t;
+                steps++;
+            }
+
+            if (B == 0)
+            {
+                return false;
+            }
+
+            // (u, v) = (A u + B v, C u + D v)
+            size_t un = combine(m_nu, (int64_t)A, (int64_t)B, m_u, m_un, m_v, m_vn);
+            size_t vn = combine(m_nv, (int64_t)C, (int64_t)D, m_u, m_un, m_v, m_vn);
+            std::swap(m_u, m_nu);
+            std::swap(m_v, m_nv);
+            m_un = un;
+            m_vn = vn;
+
+            if (extended)
+            {
+                // the signs line up so the magnitudes simply add
+                size_t x0n = combineCofactor(m_x2, (int64_t)A, (int64_t)B, m_x0, m_x0n, m_x1, m_x1n);
+                size_t x1n = combineCofactor(m_nu, (int64_t)C, (int64_t)D, m_x0, m_x0n, m_x1, m_x1n);
+                std::swap(m_x0, m_x2);
+                std::swap(m_x1, m_nu);
+                m_x0n = x0n;
+                m_x1n = x1n;
+            }
+
+            m_steps += steps;
+            return true;
+        }
+
+        // remainders u and v, with their sizes in limbs
+        std::vector<limb_t> m_u, m_v;
+        size_t m_un, m_vn;
+
+        // cofactor magnitudes of a for u and v
+        std::vector<limb_t> m_x0, m_x1;
+        size_t m_x0n, m_x1n;
+
+        // number of euclid steps taken, its parity gives the cofactor signs
+        size_t m_steps;
+
+        // working space
+        std::vector<limb_t> m_nu, m_nv, m_t1, m_t2, m_x2, m_q, m_scratch;
+    };
+}
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef hex_hpp
+#define hex_hpp
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CRYPTO_HEX_X86 1
+#endif
+
+namespace crypto
+{
+    // byte <-> hex text kernels, two lowercase characters per byte
+    // every kernel handles any length, the vector ones finish the tail with scalar
+    // decoders accept either letter case and return false on a character that is not a hex digit
+    namespace hexCodec
+    {
+        void encodeScalar(const uint8_t *in, size_t n, char *out)
+        {
+            static const char digits[] = "0123456789abcdef";
+            for (size_t i = 0; i < n; i++)
+            {
+                out[2 * i] = digits[in[i] >> 4];
+                out[2 * i + 1] = digits[in[i] & 15];
+            }
+        }
+
+        // value of a hex digit, or -1
+        int nibble(char c)
+        {
+            if (c >= '0' && c <= '9')
+            {
+                return c - '0';
+            }
+            c |= 0x20;
+            if (c >= 'a' && c <= 'f')
+            {
+                return c - 'a' + 10;
+            }
+            return -1;
+        }
+
+        // n bytes from 2 n characters
+        bool decodeScalar(const char *in, size_t n, uint8_t *out)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                int hi = nibble(in[2 * i]), lo = nibble(in[2 * i + 1]);
+                if (hi < 0 || lo < 0)
+                {
+                    return false;
+                }
+                out[i] = (uint8_t)(hi << 4 | lo);
+            }
+            return true;
+        }
+
+#ifdef CRYPTO_HEX_X86
+
+        // nibbles 0-15 in each byte to '0'-'9', 'a'-'f'
+        inline __m128i toAscii(__m128i d)
+        {
+            __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+            return _mm_add_epi8(_mm_add_epi8(d, _mm_set1_epi8('0')), letters);
+        }
+
+        // characters to nibbles, invalid is set in every byte that is not a hex digit
+        inline __m128i fromAscii(__m128i c, __m128i &invalid)
+        {
+            __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+            __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+            __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+            __m128i letter = _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10));
+            __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+            invalid = _mm_or_si128(invalid, _mm_andnot_si128(_mm_or_si128(isDigit, isLetter), _mm_set1_epi8(-1)));
+            return _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, letter));
+        }
+
+        // pairs of nibbles, high one first, packed into bytes in each 16 bit lane
+        inline __m128i joinNibbles(__m128i v)
+        {
+            __m128i hi = _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0xff)), 4);
+            return _mm_or_si128(hi, _mm_srli_epi16(v, 8));
+        }
+
+        // 16 bytes per step
+        void encodeSse2(const uint8_t *in, size_t n, char *out)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+                __m128i hi = toAscii(_mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(15)));
+                __m128i lo = toAscii(_mm_and_si128(v, _mm_set1_epi8(15)));
+                _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+                _mm_storeu_si128((__m128i *)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+            }
+            encodeScalar(in + i, n - i, out + 2 * i);
+        }
+
+        // 16 bytes from 32 characters per step
+        bool decodeSse2(const char *in, size_t n, uint8_t *out)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i invalid = _mm_setzero_si128();
+                __m128i a = fromAscii(_mm_loadu_si128((const __m128i *)(in + 2 * i)), invalid);
+                __m128i b = fromAscii(_mm_loadu_si128((const __m128i *)(in + 2 * i + 16)), invalid);
+                if (_mm_movemask_epi8(invalid))
+                {
+                    return false;
+                }
+                _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(joinNibbles(a), joinNibbles(b)));
+            }
+            return decodeScalar(in + 2 * i, n - i, out + i);
+        }
+
+        // the sse2 steps on 256 bit registers, 32 bytes per step
+        // unpack and pack work within 128 bit halves, so results are permuted back in order
+        __attribute__((target("avx2")))
+        void encodeAvx2(const uint8_t *in, size_t n, char *out)
+        {
+            size_t i = 0;
+            __m256i mask = _mm256_set1_epi8(15), nine = _mm256_set1_epi8(9);
+            __m256i zero = _mm256_set1_epi8('0'), gap = _mm256_set1_epi8('a' - '0' - 10);
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+                __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+                __m256i lo = _mm256_and_si256(v, mask);
+                hi = _mm256_add_epi8(_mm256_add_epi8(hi, zero), _mm256_and_si256(_mm256_cmpgt_epi8(hi, nine), gap));
+                lo = _mm256_add_epi8(_mm256_add_epi8(lo, zero), _mm256_and_si256(_mm256_cmpgt_epi8(lo, nine), gap));
+                __m256i first = _mm256_unpacklo_epi8(hi, lo), second = _mm256_unpackhi_epi8(hi, lo);
+                _mm256_storeu_si256((__m256i *)(out + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+                _mm256_storeu_si256((__m256i *)(out + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+            }
+            encodeSse2(in + i, n - i, out + 2 * i);
+        }
+
+        __attribute__((target("avx2")))
+        bool decodeAvx2(const char *in, size_t n, uint8_t *out)
+        {
+            size_t i = 0;
+            __m256i below0 = _mm256_set1_epi8('0' - 1), above9 = _mm256_set1_epi8('9' + 1);
+            __m256i belowA = _mm256_set1_epi8('a' - 1), aboveF = _mm256_set1_epi8('f' + 1);
+            __m256i zero = _mm256_set1_epi8('0'), letterBase = _mm256_set1_epi8('a' - 10), lowerBit = _mm256_set1_epi8(0x20);
+            __m256i lowByte = _mm256_set1_epi16(0xff);
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i invalid = _mm256_setzero_si256(), joined[2];
+                for (int j = 0; j < 2; j++)
+                {
+                    __m256i c = _mm256_loadu_si256((const __m256i *)(in + 2 * i + 32 * j));
+                    __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(c, below0), _mm256_cmpgt_epi8(above9, c));
+                    __m256i lower = _mm256_or_si256(c, lowerBit);
+                    __m256i isLetter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, belowA), _mm256_cmpgt_epi8(aboveF, lower));
+                    invalid = _mm256_or_si256(invalid, _mm256_xor_si256(_mm256_or_si256(isDigit, isLetter), _mm256_set1_epi8(-1)));
+                    __m256i v = _mm256_or_si256(_mm256_and_si256(isDigit, _mm256_sub_epi8(c, zero)),
+                                                _mm256_and_si256(isLetter, _mm256_sub_epi8(lower, letterBase)));
+                    joined[j] = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(v, lowByte), 4), _mm256_srli_epi16(v, 8));
+                }
+                if (_mm256_movemask_epi8(invalid))
+                {
+                    return false;
+                }
+                __m256i packed = _mm256_packus_epi16(joined[0], joined[1]);
+                _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(packed, 0xd8));
+            }
+            return decodeSse2(in + 2 * i, n - i, out + i);
+        }
+
+#endif
+
+        typedef void (*encodeFn)(const uint8_t *, size_t, char *);
+        typedef bool (*decodeFn)(const char *, size_t, uint8_t *);
+
+        // the widest kernels this cpu runs, picked on first use
+        encodeFn bestEncoder()
+        {
+#ifdef CRYPTO_HEX_X86
+            static const encodeFn fn = __builtin_cpu_supports("avx2") ? encodeAvx2 : encodeSse2;
+            return fn;
+#else
+            return encodeScalar;
+#endif
+        }
+
+        decodeFn bestDecoder()
+        {
+#ifdef CRYPTO_HEX_X86
+            static const decodeFn fn = __builtin_cpu_supports("avx2") ? decodeAvx2 : decodeSse2;
+            return fn;
+#else
+            return decodeScalar;
+#endif
+        }
+    }
+
+    // writes the 2 n hex characters for the n bytes at in to out
+    void hexEncode(const uint8_t *in, size_t n, char *out)
+    {
+        hexCodec::bestEncoder()(in, n, out);
+    }
+
+    // writes the n bytes for the 2 n hex characters at in to out
+    // returns false if any character is not a hex digit
+    bool hexDecode(const char *in, size_t n, uint8_t *out)
+    {
+        return hexCodec::bestDecoder()(in, n, out);
+    }
+}
+
+#endif
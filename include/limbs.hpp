@@ -0,0 +1,891 @@
+#ifndef limbs_hpp
+#define limbs_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+// operand sizes (in limbs) at which multiplication switches algorithm
+#ifndef CRYPTO_KARATSUBA_THRESHOLD
+#define CRYPTO_KARATSUBA_THRESHOLD 32
+#endif
+
+#ifndef CRYPTO_TOOM3_THRESHOLD
+#define CRYPTO_TOOM3_THRESHOLD 240
+#endif
+
+// karatsuba needs a nonempty high half (n >= 2) and toom-3 a nonempty top third (n >= 5)
+static_assert(CRYPTO_KARATSUBA_THRESHOLD >= 2, "CRYPTO_KARATSUBA_THRESHOLD must be at least 2");
+static_assert(CRYPTO_TOOM3_THRESHOLD >= 5, "CRYPTO_TOOM3_THRESHOLD must be at least 5");
+
+// decimal conversion splits values longer than this many limbs in half
+#ifndef CRYPTO_RADIX_THRESHOLD
+#define CRYPTO_RADIX_THRESHOLD 32
+#endif
+
+// exponent window width in bits, 0 picks one from the exponent size
+#ifndef CRYPTO_EXP_WINDOW
+#define CRYPTO_EXP_WINDOW 0
+#endif
+
+// longest fixed width limb loop that is fully unrolled, longer ones stay loops
+#ifndef CRYPTO_UNROLL_LIMIT
+#define CRYPTO_UNROLL_LIMIT 16
+#endif
+
+namespace crypto
+{
+    // a single base 2^64 digit of a bigint, and the double width type used for carries
+    typedef uint64_t limb_t;
+    typedef unsigned __int128 dlimb_t;
+
+    // low level kernels over raw little-endian limb arrays
+    // these never allocate, callers provide output and scratch space
+    namespace limbs
+    {
+        // r = a + b over n limbs, returns the carry out
+        limb_t addN(limb_t *r, const limb_t *a, const limb_t *b, size_t n)
+        {
+            limb_t c = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                dlimb_t s = (dlimb_t)a[i] + b[i] + c;
+                r[i] = (limb_t)s;
+                c = (limb_t)(s >> 64);
+            }
+            return c;
+        }
+
+        // r = a - b over n limbs, returns the borrow out
+        limb_t subN(limb_t *r, const limb_t *a, const limb_t *b, size_t n)
+        {
+            limb_t c = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                limb_t d = a[i] - b[i] - c;
+                c = (a[i] < b[i]) || (a[i] - b[i] < c);
+                r[i] = d;
+            }
+            return c;
+        }
+
+        // r = a + c over n limbs, returns the carry out
+        limb_t add1(limb_t *r, const limb_t *a, size_t n, limb_t c)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                r[i] = a[i] + c;
+                c = r[i] < c;
+            }
+            return c;
+        }
+
+        // r = a - c over n limbs, returns the borrow out
+        limb_t sub1(limb_t *r, const limb_t *a, size_t n, limb_t c)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                limb_t d = a[i] - c;
+                c = a[i] < c;
+                r[i] = d;
+            }
+            return c;
+        }
+
+        // r = a + b where an >= bn, r holds an limbs, returns the carry out
+        limb_t add(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn)
+        {
+            limb_t c = addN(r, a, b, bn);
+            return add1(r + bn, a + bn, an - bn, c);
+        }
+
+        // r = a - b where an >= bn, r holds an limbs, returns the borrow out
+        limb_t sub(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn)
+        {
+            limb_t c = subN(r, a, b, bn);
+            return sub1(r + bn, a + bn, an - bn, c);
+        }
+
+        // compare a and b over n limbs, returns -1, 0 or 1
+        int cmpN(const limb_t *a, const limb_t *b, size_t n)
+        {
+            while (n--)
+            {
+                if (a[n] != b[n])
+                {
+                    return a[n] < b[n] ? -1 : 1;
+                }
+            }
+            return 0;
+        }
+
+        // r = |a - b| where an >= bn, r holds an limbs
+        // returns true if a < b
+        bool absDiff(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn)
+        {
+            bool less = false;
+            size_t i = an;
+            while (i > bn && a[i - 1] == 0)
+            {
+                i--;
+            }
+
+            if (i == bn)
+            {
+                less = cmpN(a, b, bn) < 0;
+            }
+
+            if (less)
+            {
+                subN(r, b, a, bn);
+                std::fill(r + bn, r + an, 0);
+            } else {
+                sub(r, a, an, b, bn);
+            }
+            return less;
+        }
+
+        // r = a * m over n limbs, returns the high limb
+        limb_t mul1(limb_t *r, const limb_t *a, size_t n, limb_t m)
+        {
+            limb_t c = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                dlimb_t s = (dlimb_t)a[i] * m + c;
+                r[i] = (limb_t)s;
+                c = (limb_t)(s >> 64);
+            }
+            return c;
+        }
+
+        // r += a * m over n limbs, returns the carry limb
+        limb_t addmul1(limb_t *r, const limb_t *a, size_t n, limb_t m)
+        {
+            limb_t c = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                dlimb_t s = (dlimb_t)a[i] * m + r[i] + c;
+                r[i] = (limb_t)s;
+                c = (limb_t)(s >> 64);
+            }
+            return c;
+        }
+
+        // r -= a * m over n limbs, returns the borrow limb
+        limb_t submul1(limb_t *r, const limb_t *a, size_t n, limb_t m)
+        {
+            limb_t c = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                dlimb_t p = (dlimb_t)a[i] * m + c;
+                limb_t lo = (limb_t)p;
+                c = (limb_t)(p >> 64) + (r[i] < lo);
+                r[i] -= lo;
+            }
+            return c;
+        }
+
+        // q = a / d over n limbs, returns a % d
+        limb_t divrem1(limb_t *q, const limb_t *a, size_t n, limb_t d)
+        {
+            dlimb_t rem = 0;
+            for (size_t i = n; i-- > 0;)
+            {
+                dlimb_t cur = (rem << 64) | a[i];
+                q[i] = (limb_t)(cur / d);
+                rem = cur % d;
+            }
+            return (limb_t)rem;
+        }
+
+        // r = a >> s over n limbs, 0 < s < 64
+        void rshift(limb_t *r, const limb_t *a, size_t n, unsigned s)
+        {
+            for (size_t i = 0; i + 1 < n; i++)
+            {
+                r[i] = (a[i] >> s) | (a[i + 1] << (64 - s));
+            }
+            r[n - 1] = a[n - 1] >> s;
+        }
+
+        // r = a << s over n limbs, 0 < s < 64, returns the bits shifted out
+        limb_t lshift(limb_t *r, const limb_t *a, size_t n, unsigned s)
+        {
+            limb_t out = a[n - 1] >> (64 - s);
+            for (size_t i = n - 1; i > 0; i--)
+            {
+                r[i] = (a[i] << s) | (a[i - 1] >> (64 - s));
+            }
+            r[0] = a[0] << s;
+            return out;
+        }
+
+        // r[off..rn) += x, dropping anything past rn
+        // the dropped part must be zero, ie the true sum fits in rn limbs
+        void addAt(limb_t *r, size_t rn, size_t off, const limb_t *x, size_t xn)
+        {
+            size_t len = std::min(xn, rn - off);
+            limb_t c = addN(r + off, r + off, x, len);
+            add1(r + off + len, r + off + len, rn - off - len, c);
+        }
+
+        // scratch limbs needed by divrem for an by bn limb operands
+        size_t divremScratch(size_t an, size_t bn)
+        {
+            return an + 1 + bn;
+        }
+
+        // knuth algorithm d, requires an >= bn >= 2 and b[bn - 1] != 0
+        // q gets the an - bn + 1 limb quotient, r the bn limb remainder
+        void divrem(limb_t *q, limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn, limb_t *scratch)
+        {
+            limb_t *u = scratch, *v = scratch + an + 1;
+
+            // normalize so the top bit of the divisor is set
+            unsigned s = __builtin_clzll(b[bn - 1]);
+            if (s)
+            {
+                u[an] = lshift(u, a, an, s);
+                lshift(v, b, bn, s);
+            } else {
+                std::copy(a, a + an, u);
+                std::copy(b, b + bn, v);
+                u[an] = 0;
+            }
+
+            limb_t vh = v[bn - 1], vl = v[bn - 2];
+            for (size_t j = an - bn + 1; j-- > 0;)
+            {
+                // estimate the quotient limb from the top two limbs,
+                // then correct with the third so it is at most one too large
+                dlimb_t num = ((dlimb_t)u[j + bn] << 64) | u[j + bn - 1];
+                dlimb_t qhat = num / vh, rhat = num % vh;
+                while ((qhat >> 64) || qhat * vl > ((rhat << 64) | u[j + bn - 2]))
+                {
+                    qhat--;
+                    rhat += vh;
+                    if (rhat >> 64)
+                    {
+                        break;
+                    }
+                }
+
+                limb_t borrow = submul1(u + j, v, bn, (limb_t)qhat);
+                limb_t top = u[j + bn];
+                u[j + bn] = top - borrow;
+                if (top < borrow)
+                {
+                    qhat--;
+                    u[j + bn] += addN(u + j, u + j, v, bn);
+                }
+
+                q[j] = (limb_t)qhat;
+            }
+
+            if (s)
+            {
+                rshift(r, u, bn, s);
+            } else {
+                std::copy(u, u + bn, r);
+            }
+        }
+
+        // window width that minimises multiplications for an exponent of the given size
+        int windowSize(size_t bits)
+        {
+            if (bits <= 16)
+            {
+                return 1;
+            }
+            if (bits <= 80)
+            {
+                return 3;
+            }
+            if (bits <= 240)
+            {
+                return 4;
+            }
+            if (bits <= 672)
+            {
+                return 5;
+            }
+            return 6;
+        }
+
+        // sliding window exponentiation over the low bits of the exponent e
+        // the caller precomputes the odd powers base^1, base^3 .. base^(2^w - 1)
+        // and starts its accumulator at 1, sqr() squares the accumulator
+        // and mul(i) multiplies it by the odd power base^(2i + 1)
+        template <class Sqr, class Mul>
+        void slidingWindow(const limb_t *e, size_t bits, int w, Sqr sqr, Mul mul)
+        {
+            auto bit = [e](size_t i) { return (e[i / 64] >> (i % 64)) & 1; };
+
+            size_t i = bits;
+            while (i > 0)
+            {
+                if (!bit(i - 1))
+                {
+                    sqr();
+                    i--;
+                    continue;
+                }
+
+                // longest run of at most w bits starting at i - 1 that ends in a 1
+                size_t l = i > (size_t)w ? i - w : 0;
+                while (!bit(l))
+                {
+                    l++;
+                }
+
+                limb_t value = 0;
+                for (size_t j = i; j-- > l;)
+                {
+                    sqr();
+                    value = (value << 1) | bit(j);
+                }
+                mul(value >> 1);
+                i = l;
+            }
+        }
+
+        // one step of a recoded exponent: square the accumulator
+        // squarings times, then multiply by odd power index unless it is negative
+        struct windowStep
+        {
+            size_t squarings;
+            long index;
+        };
+
+        // recode an exponent into sliding window steps once,
+        // so many exponentiations by the same exponent can share it
+        std::vector<windowStep> recodeWindow(const limb_t *e, size_t bits, int w)
+        {
+            std::vector<windowStep> steps;
+            size_t pending = 0;
+            slidingWindow(e, bits, w,
+                [&]() { pending++; },
+                [&](size_t i) { steps.push_back({pending, (long)i}); pending = 0; });
+
+            if (pending)
+            {
+                steps.push_back({pending, -1});
+            }
+            return steps;
+        }
+
+        // -n0^-1 mod 2^64 for odd n0, by newton iteration
+        limb_t montInverse(limb_t n0)
+        {
+            limb_t inv = n0;
+            for (int i = 0; i < 5; i++)
+            {
+                inv *= 2 - n0 * inv;
+            }
+            return -inv;
+        }
+
+        // final conditional subtraction of a montgomery product, t holds s + 1 limbs below 2n
+        void montFinal(limb_t *r, const limb_t *t, const limb_t *n, size_t s)
+        {
+            if (t[s] || cmpN(t, n, s) >= 0)
+            {
+                subN(r, t, n, s);
+            } else {
+                std::copy(t, t + s, r);
+            }
+        }
+
+        // montgomery product r = a b R^-1 mod n over s limbs, R = 2^(64 s)
+        // coarsely integrated operand scanning (cios), t needs s + 2 limbs
+        // a and b must be below n, r may alias either of them
+        void montMul(limb_t *r, const limb_t *a, const limb_t *b, const limb_t *n, size_t s, limb_t nprime, limb_t *t)
+        {
+            std::fill(t, t + s + 2, 0);
+            for (size_t i = 0; i < s; i++)
+            {
+                // t += a * b[i]
+                limb_t c = 0;
+                for (size_t j = 0; j < s; j++)
+                {
+                    dlimb_t p = (dlimb_t)a[j] * b[i] + t[j] + c;
+                    t[j] = (limb_t)p;
+                    c = (limb_t)(p >> 64);
+                }
+                dlimb_t p = (dlimb_t)t[s] + c;
+                t[s] = (limb_t)p;
+                t[s + 1] = (limb_t)(p >> 64);
+
+                // t = (t + m n) / 2^64, with m chosen so the low limb cancels
+                limb_t m = t[0] * nprime;
+                p = (dlimb_t)m * n[0] + t[0];
+                c = (limb_t)(p >> 64);
+                for (size_t j = 1; j < s; j++)
+                {
+                    p = (dlimb_t)m * n[j] + t[j] + c;
+                    t[j - 1] = (limb_t)p;
+                    c = (limb_t)(p >> 64);
+                }
+                p = (dlimb_t)t[s] + c;
+                t[s - 1] = (limb_t)p;
+                t[s] = t[s + 1] + (limb_t)(p >> 64);
+            }
+
+            montFinal(r, t, n, s);
+        }
+
+        // two independent montgomery products in one pass over the limbs,
+        // giving the multiplier two dependency chains to overlap
+        // t needs 2 (s + 2) limbs
+        void montMul2(limb_t *r0, const limb_t *a0, const limb_t *b0,
+                      limb_t *r1, const limb_t *a1, const limb_t *b1,
+                      const limb_t *n, size_t s, limb_t nprime, limb_t *t)
+        {
+            limb_t *t0 = t, *t1 = t + s + 2;
+            std::fill(t, t + 2 * (s + 2), 0);
+            for (size_t i = 0; i < s; i++)
+            {
+                limb_t c0 = 0, c1 = 0;
+                for (size_t j = 0; j < s; j++)
+                {
+                    dlimb_t p0 = (dlimb_t)a0[j] * b0[i] + t0[j] + c0;
+                    dlimb_t p1 = (dlimb_t)a1[j] * b1[i] + t1[j] + c1;
+                    t0[j] = (limb_t)p0;
+                    t1[j] = (limb_t)p1;
+                    c0 = (limb_t)(p0 >> 64);
+                    c1 = (limb_t)(p1 >> 64);
+                }
+                dlimb_t p0 = (dlimb_t)t0[s] + c0, p1 = (dlimb_t)t1[s] + c1;
+                t0[s] = (limb_t)p0;
+                t1[s] = (limb_t)p1;
+                t0[s + 1] = (limb_t)(p0 >> 64);
+                t1[s + 1] = (limb_t)(p1 >> 64);
+
+                limb_t m0 = t0[0] * nprime, m1 = t1[0] * nprime;
+                p0 = (dlimb_t)m0 * n[0] + t0[0];
+                p1 = (dlimb_t)m1 * n[0] + t1[0];
+                c0 = (limb_t)(p0 >> 64);
+                c1 = (limb_t)(p1 >> 64);
+                for (size_t j = 1; j < s; j++)
+                {
+                    p0 = (dlimb_t)m0 * n[j] + t0[j] + c0;
+                    p1 = (dlimb_t)m1 * n[j] + t1[j] + c1;
+                    t0[j - 1] = (limb_t)p0;
+                    t1[j - 1] = (limb_t)p1;
+                    c0 = (limb_t)(p0 >> 64);
+                    c1 = (limb_t)(p1 >> 64);
+                }
+                p0 = (dlimb_t)t0[s] + c0;
+                p1 = (dlimb_t)t1[s] + c1;
+                t0[s - 1] = (limb_t)p0;
+                t1[s - 1] = (limb_t)p1;
+                t0[s] = t0[s + 1] + (limb_t)(p0 >> 64);
+                t1[s] = t1[s + 1] + (limb_t)(p1 >> 64);
+            }
+
+            montFinal(r0, t0, n, s);
+            montFinal(r1, t1, n, s);
+        }
+
+        template <class F, size_t... I>
+        constexpr void unrollIndices(F &f, std::index_sequence<I...>)
+        {
+            (f(std::integral_constant<size_t, I>()), ...);
+        }
+
+        // calls f(0), f(1) ... f(N - 1) in order, with the loop fully unrolled
+        // and every index a compile time constant up to CRYPTO_UNROLL_LIMIT
+        // past that the unrolled body outgrows the instruction cache and inlining
+        // gives up, so it is left as a loop with a constant trip count
+        template <size_t N, class F>
+        constexpr void unroll(F &&f)
+        {
+            if constexpr (N <= CRYPTO_UNROLL_LIMIT)
+            {
+                unrollIndices(f, std::make_index_sequence<N>());
+            } else {
+                for (size_t i = 0; i < N; i++)
+                {
+                    f(i);
+                }
+            }
+        }
+
+        // montgomery product over a compile time number of limbs S
+        // the same cios as montMul, with the inner loops unrolled and t on the stack
+        template <size_t S>
+        void montMulFixed(limb_t *r, const limb_t *a, const limb_t *b, const limb_t *n, limb_t nprime)
+        {
+            limb_t t[S + 2] = {};
+            for (size_t i = 0; i < S; i++)
+            {
+                // t += a * b[i]
+                limb_t c = 0, bi = b[i];
+                unroll<S>([&](size_t j)
+                {
+                    dlimb_t p = (dlimb_t)a[j] * bi + t[j] + c;
+                    t[j] = (limb_t)p;
+                    c = (limb_t)(p >> 64);
+                });
+                dlimb_t p = (dlimb_t)t[S] + c;
+                t[S] = (limb_t)p;
+                t[S + 1] = (limb_t)(p >> 64);
+
+                // t = (t + m n) / 2^64
+                limb_t m = t[0] * nprime;
+                p = (dlimb_t)m * n[0] + t[0];
+                c = (limb_t)(p >> 64);
+                unroll<S - 1>([&](size_t j)
+                {
+                    dlimb_t q = (dlimb_t)m * n[j + 1] + t[j + 1] + c;
+                    t[j] = (limb_t)q;
+                    c = (limb_t)(q >> 64);
+                });
+                p = (dlimb_t)t[S] + c;
+                t[S - 1] = (limb_t)p;
+                t[S] = t[S + 1] + (limb_t)(p >> 64);
+            }
+
+            montFinal(r, t, n, S);
+        }
+
+        // r = a - b over n limbs without data dependent branches, returns the borrow out
+        limb_t subCt(limb_t *r, const limb_t *a, const limb_t *b, size_t n)
+        {
+            limb_t c = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                dlimb_t d = (dlimb_t)a[i] - b[i] - c;
+                r[i] = (limb_t)d;
+                c = (limb_t)(d >> 64) & 1;
+            }
+            return c;
+        }
+
+        // r = a + (b & mask) over n limbs without data dependent branches, returns the carry out
+        limb_t addMaskedCt(limb_t *r, const limb_t *a, const limb_t *b, limb_t mask, size_t n)
+        {
+            limb_t c = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                dlimb_t s = (dlimb_t)a[i] + (b[i] & mask) + c;
+                r[i] = (limb_t)s;
+                c = (limb_t)(s >> 64);
+            }
+            return c;
+        }
+
+        // r = mask ? a : r over n limbs, mask is all ones or all zeros
+        void selectCt(limb_t *r, const limb_t *a, limb_t mask, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                r[i] ^= (r[i] ^ a[i]) & mask;
+            }
+        }
+
+        // r = a mod m over n limbs for an an limb a, in constant time
+        // shifts a into an n + 1 limb remainder a bit at a time from the top and
+        // subtracts m under a mask after every bit, 64 an steps whatever the values
+        // scratch needs 2 (n + 1) limbs
+        void secReduce(limb_t *r, const limb_t *a, size_t an, const limb_t *m, size_t n, limb_t *scratch)
+        {
+            limb_t *t = scratch, *d = t + n + 1;
+            std::fill(t, t + n + 1, 0);
+            for (size_t i = 64 * an; i-- > 0;)
+            {
+                // t < m, so 2 t + bit < 2 m fits and one subtraction brings it back below m
+                lshift(t, t, n + 1, 1);
+                t[0] |= a[i / 64] >> (i % 64) & 1;
+
+                limb_t borrow = subCt(d, t, m, n);
+                d[n] = t[n] - borrow;
+                limb_t under = (limb_t)(((dlimb_t)t[n] - borrow) >> 64) & 1;
+                selectCt(t, d, under - 1, n + 1);
+            }
+            std::copy(t, t + n, r);
+        }
+
+        // scratch limbs needed by secInvert for n limb operands
+        size_t secInvertScratch(size_t n)
+        {
+            return 7 * n;
+        }
+
+        // r = a^-1 mod m over n limbs for odd m and a < m, in constant time
+        // binary extended euclid run for a fixed 128 n iterations with masked
+        // updates, so neither branches nor memory accesses depend on a or m
+        // keeps x = u a and y = v a mod m while x shrinks to 0 and y to gcd(a, m)
+        // returns false if a and m are not coprime
+        bool secInvert(limb_t *r, const limb_t *a, const limb_t *m, size_t n, limb_t *scratch)
+        {
+            limb_t *x = scratch, *y = x + n, *u = y + n, *v = u + n;
+            limb_t *d = v + n, *e = d + n, *f = e + n;
+            std::copy(a, a + n, x);
+            std::copy(m, m + n, y);
+            std::fill(u, u + n, 0);
+            std::fill(v, v + n, 0);
+            u[0] = 1;
+
+            for (size_t i = 0; i < 128 * n; i++)
+            {
+                // for odd x: if x < y swap the two, then x -= y
+                limb_t odd = -(x[0] & 1);
+                limb_t swap = odd & -subCt(d, x, y, n);
+
+                // y takes the old x, x becomes |x - y|, negating d when swapping
+                selectCt(y, x, swap, n);
+                for (size_t j = 0; j < n; j++)
+                {
+                    d[j] ^= swap;
+                }
+                add1(d, d, n, swap & 1);
+                selectCt(x, d, odd, n);
+
+                // the same on the cofactors mod m: u = u - v or v - u, v takes the old u
+                addMaskedCt(e, e, m, -subCt(e, u, v, n), n);
+                addMaskedCt(f, f, m, -subCt(f, v, u, n), n);
+                selectCt(v, u, swap, n);
+                selectCt(u, e, odd & ~swap, n);
+                selectCt(u, f, swap, n);
+
+                // x is even now, halve it and u mod m
+                rshift(x, x, n, 1);
+                limb_t c = addMaskedCt(u, u, m, -(u[0] & 1), n);
+                rshift(u, u, n, 1);
+                u[n - 1] |= c << 63;
+            }
+
+            // gcd must be 1
+            limb_t diff = y[0] ^ 1;
+            for (size_t j = 1; j < n; j++)
+            {
+                diff |= y[j];
+            }
+            std::copy(v, v + n, r);
+            return diff == 0;
+        }
+
+        // schoolbook multiplication, r holds an + bn limbs and must not overlap a or b
+        void mulBasecase(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn)
+        {
+            r[bn] = mul1(r, b, bn, a[0]);
+            for (size_t i = 1; i < an; i++)
+            {
+                r[i + bn] = addmul1(r + i, b, bn, a[i]);
+            }
+        }
+
+        void mulN(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *scratch);
+
+        // scratch limbs needed by mulN for n limb operands
+        size_t mulNScratch(size_t n)
+        {
+            if (n < CRYPTO_KARATSUBA_THRESHOLD)
+            {
+                return 0;
+            }
+
+            if (n < CRYPTO_TOOM3_THRESHOLD)
+            {
+                size_t h = (n + 1) / 2;
+                return 4 * h + 1 + mulNScratch(h);
+            }
+
+            size_t k = (n + 2) / 3;
+            return 6 * (k + 1) + 4 * (2 * k + 2) + mulNScratch(k + 1);
+        }
+
+        // karatsuba multiplication of two n limb operands into 2n limbs
+        // splits a = a1 B^h + a0 and uses a0 b1 + a1 b0 = a0 b0 + a1 b1 - (a0 - a1)(b0 - b1)
+        void mulKaratsuba(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *scratch)
+        {
+            size_t h = (n + 1) / 2, l = n - h;
+            limb_t *da = scratch, *db = scratch + h, *mid = scratch + 2 * h + 1;
+            limb_t *t = scratch, *rec = scratch + 4 * h + 1;
+
+            // low and high products land directly in the result
+            mulN(r, a, b, h, rec);
+            mulN(r + 2 * h, a + h, b + h, l, rec);
+
+            bool negA = absDiff(da, a, h, a + h, l);
+            bool negB = absDiff(db, b, h, b + h, l);
+            mulN(mid, da, db, h, rec);
+
+            // t = a0 b0 + a1 b1 -/+ |a0 - a1||b0 - b1|
+            t[2 * h] = add(t, r, 2 * h, r + 2 * h, 2 * l);
+            if (negA == negB)
+            {
+                t[2 * h] -= subN(t, t, mid, 2 * h);
+            } else {
+                t[2 * h] += addN(t, t, mid, 2 * h);
+            }
+
+            addAt(r, 2 * n, h, t, 2 * h + 1);
+        }
+
+        // toom-3 multiplication of two n limb operands into 2n limbs
+        // evaluates at 0, 1, -1, 2 and infinity, interpolating modulo B^(2k + 2)
+        // where every intermediate fits, so negative values simply wrap
+        void mulToom3(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *scratch)
+        {
+            size_t k = (n + 2) / 3, l = n - 2 * k, L = 2 * k + 2;
+            const limb_t *a0 = a, *a1 = a + k, *a2 = a + 2 * k;
+            const limb_t *b0 = b, *b1 = b + k, *b2 = b + 2 * k;
+
+            limb_t *pa1 = scratch, *pam1 = pa1 + (k + 1), *pa2 = pam1 + (k + 1);
+            limb_t *pb1 = pa2 + (k + 1), *pbm1 = pb1 + (k + 1), *pb2 = pbm1 + (k + 1);
+            limb_t *w1 = pb2 + (k + 1), *wm1 = w1 + L, *w2 = wm1 + L, *t = w2 + L;
+            limb_t *rec = t + L;
+
+            // evaluate each operand at 1, -1 and 2
+            bool neg = false;
+            for (int side = 0; side < 2; side++)
+            {
+                const limb_t *x0 = side ? b0 : a0, *x1 = side ? b1 : a1, *x2 = side ? b2 : a2;
+                limb_t *p1 = side ? pb1 : pa1, *pm1 = side ? pbm1 : pam1, *p2 = side ? pb2 : pa2;
+
+                // t = x0 + x2
+                t[k] = add(t, x0, k, x2, l);
+                p1[k] = t[k] + addN(p1, t, x1, k);
+                neg ^= absDiff(pm1, t, k + 1, x1, k);
+
+                dlimb_t c = 0;
+                for (size_t i = 0; i < k; i++)
+                {
+                    dlimb_t s = (dlimb_t)x0[i] + 2 * (dlimb_t)x1[i] + c;
+                    if (i < l)
+                    {
+                        s += 4 * (dlimb_t)x2[i];
+                    }
+                    p2[i] = (limb_t)s;
+                    c = s >> 64;
+                }
+                p2[k] = (limb_t)c;
+            }
+
+            mulN(w1, pa1, pb1, k + 1, rec);
+            mulN(wm1, pam1, pbm1, k + 1, rec);
+            mulN(w2, pa2, pb2, k + 1, rec);
+            if (neg)
+            {
+                // two's complement negate
+                for (size_t i = 0; i < L; i++)
+                {
+                    wm1[i] = ~wm1[i];
+                }
+                add1(wm1, wm1, L, 1);
+            }
+
+            // w0 and winf go straight into the result
+            mulN(r, a0, b0, k, rec);
+            std::fill(r + 2 * k, r + 4 * k, 0);
+            mulN(r + 4 * k, a2, b2, l, rec);
+            const limb_t *w0 = r, *winf = r + 4 * k;
+
+            // t = (w1 + wm1) / 2 - w0 - winf = r2
+            addN(t, w1, wm1, L);
+            rshift(t, t, L, 1);
+            sub(t, t, L, w0, 2 * k);
+            sub(t, t, L, winf, 2 * l);
+
+            // wm1 = (w1 - wm1) / 2 = r1 + r3
+            subN(wm1, w1, wm1, L);
+            rshift(wm1, wm1, L, 1);
+
+            // w2 = ((w2 - w0 - 4 r2 - 16 winf) / 2 - (r1 + r3)) / 3 = r3
+            sub(w2, w2, L, w0, 2 * k);
+            submul1(w2, t, L, 4);
+            sub1(w2 + 2 * l, w2 + 2 * l, L - 2 * l, submul1(w2, winf, 2 * l, 16));
+            rshift(w2, w2, L, 1);
+            subN(w2, w2, wm1, L);
+            divrem1(w2, w2, L, 3);
+
+            // wm1 = r1
+            subN(wm1, wm1, w2, L);
+
+            addAt(r, 2 * n, k, wm1, L);
+            addAt(r, 2 * n, 2 * k, t, L);
+            addAt(r, 2 * n, 3 * k, w2, L);
+        }
+
+        // multiply two n limb operands into 2n limbs, picking the algorithm by size
+        void mulN(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *scratch)
+        {
+            if (n < CRYPTO_KARATSUBA_THRESHOLD)
+            {
+                mulBasecase(r, a, n, b, n);
+            } else if (n < CRYPTO_TOOM3_THRESHOLD) {
+                mulKaratsuba(r, a, b, n, scratch);
+            } else {
+                mulToom3(r, a, b, n, scratch);
+            }
+        }
+
+        // scratch limbs needed by mul for an by bn limb operands
+        size_t mulScratch(size_t an, size_t bn)
+        {
+            if (an < bn)
+            {
+                std::swap(an, bn);
+            }
+
+            if (bn < CRYPTO_KARATSUBA_THRESHOLD)
+            {
+                return 0;
+            }
+
+            if (an == bn)
+            {
+                return mulNScratch(bn);
+            }
+
+            size_t cn = an % bn;
+            return 2 * bn + std::max(mulNScratch(bn), cn ? mulScratch(bn, cn) : 0);
+        }
+
+        // multiply an limbs by bn limbs into an + bn limbs
+        // unbalanced operands are cut into bn sized blocks of the longer one
+        void mul(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn, limb_t *scratch)
+        {
+            if (an < bn)
+            {
+                std::swap(a, b);
+                std::swap(an, bn);
+            }
+
+            if (bn < CRYPTO_KARATSUBA_THRESHOLD)
+            {
+                mulBasecase(r, a, an, b, bn);
+                return;
+            }
+
+            if (an == bn)
+            {
+                mulN(r, a, b, bn, scratch);
+                return;
+            }
+
+            limb_t *t = scratch, *rec = scratch + 2 * bn;
+            std::fill(r, r + an + bn, 0);
+
+            size_t i = 0;
+            for (; i + bn <= an; i += bn)
+            {
+                mulN(t, a + i, b, bn, rec);
+                addAt(r, an + bn, i, t, 2 * bn);
+            }
+
+            if (i < an)
+            {
+                mul(t, b, bn, a + i, an - i, rec);
+                addAt(r, an + bn, i, t, bn + an - i);
+            }
+        }
+    }
+}
+
+#endif
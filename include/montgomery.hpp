@@ -0,0 +1,445 @@
+#ifndef montgomery_hpp
+#define montgomery_hpp
+
+#include <vector>
+#include <memory>
+
+#include <types.hpp>
+#include <fixed.hpp>
+
+namespace crypto
+{
+    // montgomery arithmetic modulo a fixed odd n
+    // the setup (n' and R^2 mod n) is paid once per modulus,
+    // after that modexp runs without any long division
+    class montgomeryContext
+    {
+    public:
+
+        montgomeryContext(const bigint &n)
+        {
+            if (!(n[0] & 1) || n == 1)
+            {
+                throw("Arithmetic Error: Montgomery modulus must be odd");
+            }
+
+            m_n = n;
+            m_size = n.limbs.size();
+            m_nprime = limbs::montInverse(n.limbs[0]);
+
+            // R^2 mod n, R = 2^(64 s)
+            bigint r2;
+            r2.limbs.assign(2 * m_size + 1, 0);
+            r2.limbs[2 * m_size] = 1;
+            r2 %= n;
+            m_r2 = load(r2);
+
+            // R mod n, montgomery form of 1
+            limbBuffer<1> t(m_size + 2), one(m_size, 0);
+            one[0] = 1;
+            m_one.resize(m_size);
+            montMul(m_one.data(), m_r2.data(), one.data(), t.data());
+        }
+
+        // the modulus this context reduces by
+        const bigint &modulus() const
+        {
+            return m_n;
+        }
+
+        // x R mod n
+        bigint toMont(const bigint &x) const
+        {
+            limbBuffer<1> a = load(reduce(x)), t(m_size + 2);
+            montMul(a.data(), a.data(), m_r2.data(), t.data());
+            return store(a.data());
+        }
+
+        // x R^-1 mod n, takes x back out of montgomery form
+        bigint fromMont(const bigint &x) const
+        {
+            limbBuffer<1> a = load(x), one(m_size, 0), t(m_size + 2);
+            one[0] = 1;
+            montMul(a.data(), a.data(), one.data(), t.data());
+            return store(a.data());
+        }
+
+        // montgomery product a b R^-1 mod n of two values in montgomery form
+        bigint mul(const bigint &a, const bigint &b) const
+        {
+            bigint r;
+            mul(r, a, b);
+            return r;
+        }
+
+        // r = a b R^-1 mod n in r's existing storage, r may alias a or b
+        // works in a per thread buffer so repeated products do not allocate
+        void mul(bigint &r, const bigint &a, const bigint &b) const
+        {
+            static thread_local std::vector<limb_t> buf;
+            size_t s = m_size;
+            if (buf.size() < 3 * s + 2)
+            {
+                buf.resize(3 * s + 2);
+            }
+
+            limb_t *x = buf.data(), *y = x + s, *t = y + s;
+            std::fill(std::copy(a.limbs.begin(), a.limbs.end(), x), x + s, 0);
+            std::fill(std::copy(b.limbs.begin(), b.limbs.end(), y), y + s, 0);
+            montMul(x, x, y, t);
+
+            r.limbs.assign(x, x + s);
+            r.trim();
+        }
+
+        // x^y mod n, taking and returning ordinary (non montgomery) values
+        // sliding window of the given width over the exponent bits, 0 picks one by size
+        bigint modexp(const bigint &x, const bigint &y, int window = CRYPTO_EXP_WINDOW) const
+        {
+            size_t s = m_size, bits = bitLength(y);
+            int w = window > 0 ? window : limbs::windowSize(bits);
+
+            // one block holding the table of odd powers x R, x^3 R, x^5 R ...,
+            // the accumulator, x^2 R, x and the montMul scratch
+            // as a limbBuffer it comes from the scratch arena when one is open
+            size_t count = (size_t)1 << (w - 1);
+            limbBuffer<1> work;
+            work.resize((count + 4) * s + 2);
+            limb_t *table = work.data(), *acc = table + count * s, *square = acc + s, *base = square + s, *t = base + s;
+
+            bigint xr = reduce(x);
+            std::fill(std::copy(xr.limbs.begin(), xr.limbs.end(), base), base + s, 0);
+            std::copy(m_one.begin(), m_one.end(), acc);
+            montMul(table, base, m_r2.data(), t);
+            if (w > 1)
+            {
+                montMul(square, table, table, t);
+                for (size_t i = 1; i < count; i++)
+                {
+                    montMul(table + i * s, table + (i - 1) * s, square, t);
+                }
+            }
+
+            limbs::slidingWindow(y.limbs.data(), bits, w,
+                [&]() { montMul(acc, acc, acc, t); },
+                [&](size_t i) { montMul(acc, acc, table + i * s, t); });
+
+            // multiply by plain 1 to leave montgomery form
+            std::fill(base, base + s, 0);
+            base[0] = 1;
+            montMul(acc, acc, base, t);
+            return store(acc);
+        }
+
+        // out[i] = x[i]^y mod n for every i < count
+        // the exponent is recoded once for the whole batch and values are
+        // exponentiated two at a time in lockstep through montMul2
+        void modexpBatch(const bigint *x, size_t count, const bigint &y, bigint *out, int window = CRYPTO_EXP_WINDOW) const
+        {
+            size_t s = m_size, bits = bitLength(y);
+            int w = window > 0 ? window : limbs::windowSize(bits);
+            std::vector<limbs::windowStep> steps = limbs::recodeWindow(y.limbs.data(), bits, w);
+
+            size_t tableSize = ((size_t)1 << (w - 1)) * s;
+            limbBuffer<1> table(2 * tableSize), acc(2 * s), square(s), t(2 * (s + 2)), one(s, 0);
+            one[0] = 1;
+
+            for (size_t i = 0; i < count; i += 2)
+            {
+                size_t lanes = std::min((size_t)2, count - i);
+                for (size_t lane = 0; lane < lanes; lane++)
+                {
+                    // odd powers for this lane, as in modexp
+                    limb_t *tab = &table[lane * tableSize];
+                    limbBuffer<1> base = load(reduce(x[i + lane]));
+                    montMul(tab, base.data(), m_r2.data(), t.data());
+                    if (w > 1)
+                    {
+                        montMul(square.data(), tab, tab, t.data());
+                        for (size_t j = s; j < tableSize; j += s)
+                        {
+                            montMul(tab + j, tab + j - s, square.data(), t.data());
+                        }
+                    }
+                    std::copy(m_one.begin(), m_one.end(), &acc[lane * s]);
+                }
+
+                limb_t *acc0 = &acc[0], *acc1 = &acc[s];
+                const limb_t *tab0 = &table[0], *tab1 = &table[tableSize];
+                for (const limbs::windowStep &step : steps)
+                {
+                    for (size_t j = 0; j < step.squarings; j++)
+                    {
+                        if (lanes == 2)
+                        {
+                            montMul2(acc0, acc0, acc0, acc1, acc1, acc1, t.data());
+                        } else {
+                            montMul(acc0, acc0, acc0, t.data());
+                        }
+                    }
+
+                    if (step.index >= 0)
+                    {
+                        if (lanes == 2)
+                        {
+                            montMul2(acc0, acc0, tab0 + step.index * s, acc1, acc1, tab1 + step.index * s, t.data());
+                        } else {
+                            montMul(acc0, acc0, tab0 + step.index * s, t.data());
+                        }
+                    }
+                }
+
+                for (size_t lane = 0; lane < lanes; lane++)
+                {
+                    montMul(&acc[lane * s], &acc[lane * s], one.data(), t.data());
+                    out[i + lane] = store(&acc[lane * s]);
+                }
+            }
+        }
+
+    private:
+
+        // two independent montgomery products over this modulus, t needs 2 (m_size + 2) limbs
+        void montMul2(limb_t *r0, const limb_t *a0, const limb_t *b0, limb_t *r1, const limb_t *a1, const limb_t *b1, limb_t *t) const
+        {
+            limbs::montMul2(r0, a0, b0, r1, a1, b1, m_n.limbs.data(), m_size, m_nprime, t);
+        }
+
+        // montgomery product over this modulus, t needs m_size + 2 limbs
+        void montMul(limb_t *r, const limb_t *a, const limb_t *b, limb_t *t) const
+        {
+            limbs::montMul(r, a, b, m_n.limbs.data(), m_size, m_nprime, t);
+        }
+
+        // x mod n, skipping the division when x is already reduced
+        bigint reduce(const bigint &x) const
+        {
+            bigint r(x);
+            if (r >= m_n)
+            {
+                r %= m_n;
+            }
+            return r;
+        }
+
+        // copy a reduced value into m_size limbs
+        limbBuffer<1> load(const bigint &x) const
+        {
+            limbBuffer<1> v(m_size);
+            std::copy(x.limbs.begin(), x.limbs.end(), v.begin());
+            return v;
+        }
+
+        // read m_size limbs back into a bigint
+        bigint store(const limb_t *v) const
+        {
+            bigint r;
+            r.limbs.assign(v, v + m_size);
+            r.trim();
+            return r;
+        }
+
+        // modulus
+        bigint m_n;
+
+        // number of limbs in the modulus
+        size_t m_size;
+
+        // -n^-1 mod 2^64
+        limb_t m_nprime;
+
+        // R^2 mod n and R mod n, limbBuffers so a context built inside a
+        // scratch arena keeps its setup there too
+        limbBuffer<1> m_r2;
+        limbBuffer<1> m_one;
+    };
+
+    // montgomery arithmetic modulo an odd n of a fixed width
+    // every buffer lives on the stack and the products use the unrolled
+    // montMulFixed, so modexp never touches the heap
+    template <size_t Bits>
+    class fixedMontgomeryContext
+    {
+    public:
+
+        typedef fixedUint<Bits> value;
+
+        fixedMontgomeryContext(const value &n) : m_n(n)
+        {
+            if (!(n[0] & 1) || n == 1)
+            {
+                throw("Arithmetic Error: Montgomery modulus must be odd");
+            }
+            m_nprime = limbs::montInverse(n[0]);
+
+            // R mod n, R = 2^Bits, is just R - n when n has its top bit set,
+            // otherwise double the highest power of two below n up to R
+            size_t top = n.bitLength() - 1;
+            if (top == Bits - 1)
+            {
+                m_one = value() - n;
+            } else {
+                m_one[top / 64] = (limb_t)1 << (top % 64);
+                for (size_t i = top; i < Bits; i++)
+                {
+                    doubleMod(m_one);
+                }
+            }
+
+            // R^2 mod n: with Bits = k 2^j, double R up to 2^k R, the montgomery
+            // form of 2^k, then square that j times
+            size_t j = __builtin_ctzll(Bits), k = Bits >> j;
+            m_r2 = m_one;
+            for (size_t i = 0; i < k; i++)
+            {
+                doubleMod(m_r2);
+            }
+            for (size_t i = 0; i < j; i++)
+            {
+                montMul(m_r2, m_r2, m_r2);
+            }
+        }
+
+        const value &modulus() const
+        {
+            return m_n;
+        }
+
+        // x R mod n for any x below 2^Bits
+        value toMont(const value &x) const
+        {
+            value r;
+            montMul(r, x, m_r2);
+            return r;
+        }
+
+        // x R mod n for a double width x, as met by crt: x = h 2^Bits + l
+        // gives h R^2 + l R, where R^3 comes from one more product
+        value toMont(const fixedUint<2 * Bits> &x) const
+        {
+            value h, l, r3, r;
+            for (size_t i = 0; i < value::size; i++)
+            {
+                l[i] = x[i];
+                h[i] = x[i + value::size];
+            }
+            montMul(r3, m_r2, m_r2);
+            montMul(h, h, r3);
+            montMul(l, l, m_r2);
+            addMod(r, h, l);
+            return r;
+        }
+
+        value fromMont(const value &x) const
+        {
+            value r;
+            montMul(r, x, value(1));
+            return r;
+        }
+
+        // a b R^-1 mod n
+        value mul(const value &a, const value &b) const
+        {
+            value r;
+            montMul(r, a, b);
+            return r;
+        }
+
+        // x^y mod n, x is either Bits or 2 Bits wide, y is any fixed width
+        template <class X, size_t E>
+        value modexp(const X &x, const fixedUint<E> &y, int window = CRYPTO_EXP_WINDOW) const
+        {
+            size_t bits = y.bitLength();
+            int w = window > 0 ? window : limbs::windowSize(bits);
+            w = std::min(w, 6);
+
+            // odd powers x R, x^3 R, x^5 R ...
+            std::array<value, 32> table;
+            value acc = m_one, square;
+            table[0] = toMont(x);
+            if (w > 1)
+            {
+                montMul(square, table[0], table[0]);
+                for (size_t i = 1; i < ((size_t)1 << (w - 1)); i++)
+                {
+                    montMul(table[i], table[i - 1], square);
+                }
+            }
+
+            limbs::slidingWindow(y.data(), bits, w,
+                [&]() { montMul(acc, acc, acc); },
+                [&](size_t i) { montMul(acc, acc, table[i]); });
+
+            return fromMont(acc);
+        }
+
+        // r = a + b mod n for reduced a and b
+        void addMod(value &r, const value &a, const value &b) const
+        {
+            r = a;
+            limb_t c = r.addCarry(b);
+            if (c || r >= m_n)
+            {
+                r -= m_n;
+            }
+        }
+
+        // r = a - b mod n for reduced a and b
+        void subMod(value &r, const value &a, const value &b) const
+        {
+            r = a;
+            if (r.subBorrow(b))
+            {
+                r += m_n;
+            }
+        }
+
+    private:
+
+        void montMul(value &r, const value &a, const value &b) const
+        {
+            limbs::montMulFixed<value::size>(r.data(), a.data(), b.data(), m_n.data(), m_nprime);
+        }
+
+        // x = 2 x mod n
+        void doubleMod(value &x) const
+        {
+            if (x.shiftLeft1() || x >= m_n)
+            {
+                x -= m_n;
+            }
+        }
+
+        value m_n;
+        limb_t m_nprime;
+
+        // R mod n and R^2 mod n
+        value m_one;
+        value m_r2;
+    };
+
+    // per thread contexts for the most recently used moduli
+    // repeated operations under one key only pay the setup once,
+    // contexts stay alive until the thread exits, so only pass public moduli
+    const montgomeryContext &montgomeryCache(const bigint &n)
+    {
+        static const int slots = 4;
+        static thread_local std::unique_ptr<montgomeryContext> ctx[slots];
+        static thread_local int next = 0;
+
+        for (int i = 0; i < slots; i++)
+        {
+            if (ctx[i] && ctx[i]->modulus() == n)
+            {
+                return *ctx[i];
+            }
+        }
+
+        int i = next;
+        next = (next + 1) % slots;
+        ctx[i].reset(new montgomeryContext(n));
+        return *ctx[i];
+    }
+}
+
+#endif
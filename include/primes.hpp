@@ -0,0 +1,484 @@
+#ifndef primes_hpp
+#define primes_hpp
+
+#include <vector>
+#include <cstdint>
+
+#include <types.hpp>
+#include <random.hpp>
+#include <montgomery.hpp>
+
+// small primes below this bound are used to sieve prime candidates
+#ifndef CRYPTO_SIEVE_BOUND
+#define CRYPTO_SIEVE_BOUND 8192
+#endif
+
+// random miller rabin rounds run on top of baillie psw when generating primes
+#ifndef CRYPTO_PRIME_EXTRA_ROUNDS
+#define CRYPTO_PRIME_EXTRA_ROUNDS 0
+#endif
+
+namespace crypto
+{
+    // odd primes below CRYPTO_SIEVE_BOUND, built once
+    const std::vector<uint32_t> &smallPrimes()
+    {
+        static const std::vector<uint32_t> primes = []()
+        {
+            std::vector<bool> composite(CRYPTO_SIEVE_BOUND, false);
+            std::vector<uint32_t> found;
+            for (uint32_t i = 3; i < CRYPTO_SIEVE_BOUND; i += 2)
+            {
+                if (composite[i])
+                {
+                    continue;
+                }
+
+                found.push_back(i);
+                for (uint32_t j = i * i; j < CRYPTO_SIEVE_BOUND; j += 2 * i)
+                {
+                    composite[j] = true;
+                }
+            }
+            return found;
+        }();
+
+        return primes;
+    }
+
+    // a b mod n on machine words
+    uint64_t mulmod64(uint64_t a, uint64_t b, uint64_t n)
+    {
+        return (uint64_t)((dlimb_t)a * b % n);
+    }
+
+    // a^e mod n on machine words
+    uint64_t powmod64(uint64_t a, uint64_t e, uint64_t n)
+    {
+        uint64_t r = 1;
+        a %= n;
+        while (e)
+        {
+            if (e & 1)
+            {
+                r = mulmod64(r, a, n);
+            }
+            a = mulmod64(a, a, n);
+            e >>= 1;
+        }
+        return r;
+    }
+
+    // deterministic primality test for n < 2^64
+    // miller rabin to the first 12 prime bases is exact below 3.3 * 10^24
+    bool isPrime64(uint64_t n)
+    {
+        static const uint64_t bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+
+        if (n < 2)
+        {
+            return false;
+        }
+
+        for (uint64_t p : bases)
+        {
+            if (n % p == 0)
+            {
+                return n == p;
+            }
+        }
+
+        int r = __builtin_ctzll(n - 1);
+        uint64_t d = (n - 1) >> r;
+        for (uint64_t a : bases)
+        {
+            uint64_t x = powmod64(a, d, n);
+            if (x == 1 || x == n - 1)
+            {
+                continue;
+            }
+
+            bool composite = true;
+            for (int j = 1; j < r && composite; j++)
+            {
+                x = mulmod64(x, x, n);
+                composite = x != n - 1;
+            }
+
+            if (composite)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // odd n > 3 prepared for strong probable prime tests to many bases
+    // n - 1 = d 2^r is split once with a trailing zero count
+    class strongPrimeTest
+    {
+    public:
+
+        strongPrimeTest(const bigint &n) : m_ctx(n)
+        {
+            m_minusOne = n - 1;
+            m_r = trailingZeros(m_minusOne);
+            m_d = shiftRight(m_minusOne, m_r);
+            m_montMinusOne = m_ctx.toMont(m_minusOne);
+        }
+
+        // true if n is a strong probable prime to base a
+        bool test(const bigint &a) const
+        {
+            bigint x = m_ctx.modexp(a, m_d);
+            if (x == 1 || x == m_minusOne)
+            {
+                return true;
+            }
+
+            // square in montgomery form, in place
+            x = m_ctx.toMont(x);
+            for (int j = 1; j < m_r; j++)
+            {
+                m_ctx.mul(x, x, x);
+                if (x == m_montMinusOne)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+    private:
+
+        montgomeryContext m_ctx;
+
+        // n - 1 = d 2^r, and n - 1 in montgomery form
+        bigint m_minusOne;
+        bigint m_d;
+        int m_r;
+        bigint m_montMinusOne;
+    };
+
+    // miller rabin prime test
+    // k rounds with random bases in [2, n - 1]
+    bool millerRabin(const bigint &n, int k, prng &rng)
+    {
+        if (bitLength(n) <= 64)
+        {
+            return isPrime64(n[0]);
+        }
+
+        if (!(n[0] & 1))
+        {
+            return false;
+        }
+
+        strongPrimeTest t(n);
+        for (int i = 0; i < k; i++)
+        {
+            if (!t.test(rng.randbi(2, n - 1)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // miller rabin prime test
+    // k rounds with random bases in [2, n - 2], exact for n < 2^64
+    bool millerRabin2(const bigint &n, int k, prng &rng)
+    {
+        if (bitLength(n) <= 64)
+        {
+            return isPrime64(n[0]);
+        }
+
+        if (!(n[0] & 1))
+        {
+            return false;
+        }
+
+        strongPrimeTest t(n);
+        for (int i = 0; i < k; i++)
+        {
+            if (!t.test(rng.randbi(2, n - 2)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // jacobi symbol (a / n) on machine words, n odd
+    int jacobi64(uint64_t a, uint64_t n)
+    {
+        int j = 1;
+        a %= n;
+        while (a)
+        {
+            while (!(a & 1))
+            {
+                a >>= 1;
+                if ((n & 7) == 3 || (n & 7) == 5)
+                {
+                    j = -j;
+                }
+            }
+
+            std::swap(a, n);
+            if ((a & 3) == 3 && (n & 3) == 3)
+            {
+                j = -j;
+            }
+            a %= n;
+        }
+
+        return n == 1 ? j : 0;
+    }
+
+    // jacobi symbol (D / n) for a small odd D and odd n
+    int jacobi(long D, const bigint &n)
+    {
+        int j = 1;
+        if (D < 0)
+        {
+            // (-1 / n) = 1 if n = 1 mod 4, else -1
+            D = -D;
+            if ((n[0] & 3) == 3)
+            {
+                j = -j;
+            }
+        }
+
+        // reciprocity, both D and n are odd
+        if ((D & 3) == 3 && (n[0] & 3) == 3)
+        {
+            j = -j;
+        }
+
+        return j * jacobi64(modSmall(n, D), D);
+    }
+
+    // strong lucas probable prime test on odd n > 2^64 that is not a square,
+    // using selfridge's parameters: D the first of 5, -7, 9, -11 ... with
+    // (D / n) = -1, P = 1 and Q = (1 - D) / 4
+    bool strongLucasProbablePrime(const bigint &n)
+    {
+        long D = 5;
+        for (int tries = 0;; tries++)
+        {
+            int j = jacobi(D, n);
+            if (j == -1)
+            {
+                break;
+            }
+
+            if (j == 0)
+            {
+                // |D| shares a factor with n, and n is far larger than |D|
+                return false;
+            }
+
+            // a square never gives -1, so check for one once D is clearly struggling
+            if (tries == 8)
+            {
+                bigint root = sqrt(n);
+                if (root * root == n)
+                {
+                    return false;
+                }
+            }
+
+            D = D > 0 ? -(D + 2) : -(D - 2);
+        }
+
+        // everything below is in montgomery form, which add, subtract and halve respect
+        montgomeryContext ctx(n);
+        long Q = (1 - D) / 4;
+        bigint Dm = ctx.toMont(D > 0 ? bigint(D) : n - bigint(-D));
+        bigint Qm = ctx.toMont(Q > 0 ? bigint(Q) : n - bigint(-Q));
+
+        auto addMod = [&](const bigint &a, const bigint &b)
+        {
+            bigint r = a + b;
+            if (r >= n)
+            {
+                r -= n;
+            }
+            return r;
+        };
+        auto subMod = [&](const bigint &a, const bigint &b)
+        {
+            bigint r;
+            if (a >= b)
+            {
+                r = a - b;
+            } else {
+                r = a + n;
+                r -= b;
+            }
+            return r;
+        };
+        auto half = [&](bigint a)
+        {
+            if (a[0] & 1)
+            {
+                a += n;
+            }
+            divideBy2(a);
+            return a;
+        };
+
+        // n + 1 = d 2^s
+        bigint np1 = n + 1;
+        int s = trailingZeros(np1);
+        bigint d = shiftRight(np1, s);
+
+        // U_1 = 1, V_1 = P = 1, Q^1, then walk down the bits of d
+        bigint U = ctx.toMont(1), V, Qk;
+        V = U;
+        Qk = Qm;
+        for (int i = bitLength(d) - 2; i >= 0; i--)
+        {
+            // U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k
+            U = ctx.mul(U, V);
+            V = subMod(ctx.mul(V, V), addMod(Qk, Qk));
+            Qk = ctx.mul(Qk, Qk);
+
+            if (testBit(d, i))
+            {
+                // U_k+1 = (P U_k + V_k) / 2, V_k+1 = (D U_k + P V_k) / 2
+                bigint U1 = half(addMod(U, V));
+                V = half(addMod(ctx.mul(Dm, U), V));
+                U = U1;
+                Qk = ctx.mul(Qk, Qm);
+            }
+        }
+
+        if (null(U) || null(V))
+        {
+            return true;
+        }
+
+        for (int r = 1; r < s; r++)
+        {
+            V = subMod(ctx.mul(V, V), addMod(Qk, Qk));
+            if (null(V))
+            {
+                return true;
+            }
+            Qk = ctx.mul(Qk, Qk);
+        }
+
+        return false;
+    }
+
+    // baillie psw probable prime test
+    // a base 2 strong probable prime test followed by a strong lucas test,
+    // no composite is known to pass both, exact for n < 2^64
+    bool bailliePSW(const bigint &n)
+    {
+        if (bitLength(n) <= 64)
+        {
+            return isPrime64(n[0]);
+        }
+
+        if (!(n[0] & 1))
+        {
+            return false;
+        }
+
+        // cheap trial division first, candidates from primeSearch are already sieved
+        for (uint32_t p : smallPrimes())
+        {
+            if (p > 256)
+            {
+                break;
+            }
+            if (modSmall(n, p) == 0)
+            {
+                return false;
+            }
+        }
+
+        return strongPrimeTest(n).test(2) && strongLucasProbablePrime(n);
+    }
+
+    // primality test used when generating primes
+    // baillie psw, plus rounds extra miller rabin rounds with random bases
+    bool isProbablePrime(const bigint &n, prng &rng, int rounds = CRYPTO_PRIME_EXTRA_ROUNDS)
+    {
+        return bailliePSW(n) && (rounds == 0 || millerRabin2(n, rounds, rng));
+    }
+
+    // walks the numbers start + step, start + 2 step ... from an odd start
+    // with an even step, keeping the current candidate's residue modulo every
+    // small prime so composites with a small factor are skipped without any
+    // bigint arithmetic
+    class primeSearch
+    {
+    public:
+
+        primeSearch(const bigint &start, limb_t step = 2)
+        {
+            m_base = start;
+            m_offset = 0;
+            m_step = step;
+
+            // small starting points could hit a small prime itself, so skip the sieve
+            m_sieve = bitLength(start) > 16;
+
+            const std::vector<uint32_t> &primes = smallPrimes();
+            m_residues.resize(primes.size());
+            m_increments.resize(primes.size());
+            for (size_t i = 0; m_sieve && i < primes.size(); i++)
+            {
+                m_residues[i] = modSmall(start, primes[i]);
+                m_increments[i] = step % primes[i];
+            }
+        }
+
+        // step to the next candidate with no small factor and return it
+        bigint next()
+        {
+            const std::vector<uint32_t> &primes = smallPrimes();
+            bool divisible;
+            do
+            {
+                m_offset += m_step;
+                divisible = false;
+                for (size_t i = 0; m_sieve && i < primes.size(); i++)
+                {
+                    uint32_t r = m_residues[i] + m_increments[i];
+                    if (r >= primes[i])
+                    {
+                        r -= primes[i];
+                    }
+                    m_residues[i] = r;
+                    divisible |= r == 0;
+                }
+            } while (divisible);
+
+            return m_base + m_offset;
+        }
+
+    private:
+
+        // candidate is m_base + m_offset, moving m_step at a time
+        bigint m_base;
+        limb_t m_offset;
+        limb_t m_step;
+
+        // candidate mod smallPrimes()[i], and m_step mod smallPrimes()[i]
+        std::vector<uint32_t> m_residues;
+        std::vector<uint32_t> m_increments;
+        bool m_sieve;
+    };
+}
+
+#endif
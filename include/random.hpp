@@ -5,68 +5,338 @@
 #include <stdio.h>
 #include <time.h>
 #include <random>
+#include <memory>
+#include <algorithm>
+#include <cstring>
 #include <unistd.h>
 #include <types.hpp>
+#include <chacha.hpp>
+#include <aes.hpp>
+
+// bytes per ctr_drbg generate request, a multiple of 16 no larger than the 64k the standard allows
+// changing it changes the stream for every seed
+#ifndef CRYPTO_DRBG_REQUEST
+#define CRYPTO_DRBG_REQUEST 1024
+#endif
 
 namespace crypto
 {
+    // a source of random bytes behind a prng
+    // fill(a) then fill(b) must give the same bytes as fill(a + b), callers rely on it
+    class randomEngine
+    {
+    public:
+        virtual ~randomEngine() {}
+
+        virtual void fill(uint8_t *out, size_t n) = 0;
+        virtual std::unique_ptr<randomEngine> clone() const = 0;
+    };
+
+    // engines that make output a block at a time
+    // large requests are written straight to the caller, small ones come out of a buffer
+    template <size_t Bytes>
+    class bufferedEngine : public randomEngine
+    {
+    public:
+        void fill(uint8_t *out, size_t n) override
+        {
+            if (n == 0)
+            {
+                return;
+            }
+
+            size_t take = std::min(n, Bytes - m_used);
+            std::memcpy(out, m_buffer + m_used, take);
+            m_used += take;
+            out += take;
+            n -= take;
+
+            if (n >= Bytes)
+            {
+                size_t direct = n - n % Bytes;
+                generate(out, direct);
+                out += direct;
+                n -= direct;
+            }
+
+            if (n > 0)
+            {
+                generate(m_buffer, Bytes);
+                std::memcpy(out, m_buffer, n);
+                m_used = n;
+            }
+        }
+
+    protected:
+        // bytes is always a multiple of Bytes
+        virtual void generate(uint8_t *out, size_t bytes) = 0;
+
+        uint8_t m_buffer[Bytes];
+        size_t m_used = Bytes;
+    };
+
+    // chacha20 keystream, four blocks at a time with sse2
+    class chachaEngine : public bufferedEngine<256>
+    {
+    public:
+        chachaEngine(const uint8_t seed[48])
+        {
+            uint64_t nonce;
+            std::memcpy(&nonce, seed + 32, sizeof(nonce));
+            chacha::init(m_state, seed, nonce);
+        }
+
+        std::unique_ptr<randomEngine> clone() const override
+        {
+            return std::unique_ptr<randomEngine>(new chachaEngine(*this));
+        }
+
+    protected:
+        void generate(uint8_t *out, size_t bytes) override
+        {
+            chacha::blocks(m_state, out, bytes / 64);
+        }
+
+    private:
+        uint32_t m_state[16];
+    };
+
+    // the sp 800-90a ctr_drbg over aes-256 without a derivation function,
+    // so the 48 byte seed is used as the entropy input directly
+    // output is made in generate requests of exactly one 1k buffer, each followed by an update
+    // as the standard asks, so the stream is the same however callers split their fills
+    // it is never reseeded, a prng lives nowhere near the 2^48 request limit
+    class ctrDrbgEngine : public bufferedEngine<CRYPTO_DRBG_REQUEST>
+    {
+        static_assert(CRYPTO_DRBG_REQUEST % 16 == 0 && CRYPTO_DRBG_REQUEST <= 65536, "ctr_drbg requests are whole blocks of at most 64k");
+
+    public:
+        ctrDrbgEngine(const uint8_t seed[48])
+        {
+            uint8_t zero[32] = {};
+            aes::expandKey(m_key, zero);
+            std::memset(m_v, 0, sizeof(m_v));
+            aes::increment(m_v);
+            update(seed);
+        }
+
+        std::unique_ptr<randomEngine> clone() const override
+        {
+            return std::unique_ptr<randomEngine>(new ctrDrbgEngine(*this));
+        }
+
+    protected:
+        void generate(uint8_t *out, size_t bytes) override
+        {
+            static const uint8_t zero[48] = {};
+            for (size_t i = 0; i < bytes; i += CRYPTO_DRBG_REQUEST)
+            {
+                aes::ctr(m_key, m_v, out + i, CRYPTO_DRBG_REQUEST / 16);
+                update(zero);
+            }
+        }
+
+    private:
+        // three blocks of keystream xored with the provided data become the new key and v
+        void update(const uint8_t provided[48])
+        {
+            uint8_t temp[48];
+            aes::ctr(m_key, m_v, temp, 3);
+            for (int i = 0; i < 48; i++)
+            {
+                temp[i] ^= provided[i];
+            }
+            aes::expandKey(m_key, temp);
+            std::memcpy(m_v, temp + 32, 16);
+            aes::increment(m_v);
+        }
+
+        aes::key256 m_key;
+        // v + 1, the next counter block to encrypt
+        uint8_t m_v[16];
+    };
+
+    // the old mt19937 generator, fast and reproducible but not for real keys
+    class mtEngine : public bufferedEngine<4>
+    {
+    public:
+        mtEngine(const uint8_t seed[48])
+        {
+            uint32_t words[12];
+            std::memcpy(words, seed, sizeof(words));
+            std::seed_seq seq(words, words + 12);
+            m_generator.seed(seq);
+        }
+
+        std::unique_ptr<randomEngine> clone() const override
+        {
+            return std::unique_ptr<randomEngine>(new mtEngine(*this));
+        }
+
+    protected:
+        void generate(uint8_t *out, size_t bytes) override
+        {
+            for (size_t i = 0; i < bytes; i += 4)
+            {
+                uint32_t v = m_generator();
+                std::memcpy(out + i, &v, 4);
+            }
+        }
+
+    private:
+        std::mt19937 m_generator;
+    };
+
+    enum class rngBackend
+    {
+        chacha20,
+        ctrDrbg,
+        mt19937
+    };
+
+    // random numbers for key generation, primality tests and padding
+    // also a uniform random bit generator, so it works with the std distributions
     class prng
     {
     public:
+        typedef uint64_t result_type;
+
+        // an empty seed keys the generator from the os entropy source,
+        // any other seed gives the same stream on every run
+        prng(std::string t_seed = "", rngBackend t_backend = rngBackend::chacha20)
+        {
+            uint8_t seed[48];
+            if (t_seed == "")
+            {
+                std::random_device rd;
+                for (int i = 0; i < 48; i += 4)
+                {
+                    uint32_t v = rd();
+                    std::memcpy(seed + i, &v, 4);
+                }
+            } else {
+                chacha::derive(t_seed, seed, sizeof(seed));
+            }
+            init(t_backend, seed);
+        }
+
+        // a copy continues the same stream independently
+        // there are no move operations, a move would leave the source without an engine,
+        // so rvalues are copied too and every prng always has a working engine
+        prng(const prng &other) : m_backend(other.m_backend), m_engine(other.m_engine->clone()) {}
 
-        prng(std::string t_seed = "")
+        prng &operator=(const prng &other)
         {
-            std::random_device rd;
-            m_generator = std::mt19937(rd());
+            m_backend = other.m_backend;
+            m_engine = other.m_engine->clone();
+            return *this;
+        }
 
-            m_seed = (t_seed == "") ? std::to_string(getpid() * time(NULL)) : t_seed;
+        // n random bytes to out
+        void fill(uint8_t *out, size_t n)
+        {
+            m_engine->fill(out, n);
+        }
 
-            std::seed_seq seed(m_seed.begin(), m_seed.end());
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return ~(result_type)0; }
 
-            m_generator.seed(seed);
+        result_type operator()()
+        {
+            result_type v;
+            fill((uint8_t *)&v, sizeof(v));
+            return v;
         }
 
         float randf(float t_lower = 0.0, float t_upper = 1.0)
         {
             std::uniform_real_distribution<> dist(t_lower, t_upper);
-            return dist(m_generator);
+            return dist(*this);
         }
 
         int randi(int t_lower = 0, int t_upper = 1)
         {
             std::uniform_int_distribution<> dist(t_lower, t_upper);
-            return dist(m_generator);
+            return dist(*this);
         }
 
+        // uniform in [0, 2^bits), whole limbs straight from the engine with the top one masked
         bigint randbi(int bits)
         {
-            bool bitarray[bits];
+            bigint num;
+            if (bits <= 0)
+            {
+                return num;
+            }
 
-            for (int i = 0; i < bits; i++)
+            size_t n = (bits + 63) / 64;
+            num.limbs.resize(n);
+            fill((uint8_t *)num.limbs.data(), n * sizeof(limb_t));
+            if (bits % 64)
             {
-                bitarray[i] = randi(0, 1);
+                num.limbs[n - 1] &= ((limb_t)1 << (bits % 64)) - 1;
             }
+            num.trim();
+            return num;
+        }
 
-            bigint num;
-            for (int i = 0; i < bits; i++)
+        // uniform in [lower, upper]
+        // draws below the next power of two over the range and rejects values past it,
+        // which takes fewer than two draws on average
+        bigint randbi(const bigint &lower, const bigint &upper)
+        {
+            if (upper < lower)
             {
-                num += bigint((unsigned long long)bitarray[i]) * (bigint(2ULL) ^ bigint((unsigned long long)i));
+                throw("ERROR: empty range");
             }
 
-            return num;
+            bigint range = upper - lower, x;
+            int bits = bitLength(range);
+            do
+            {
+                x = randbi(bits);
+            } while (x > range);
+
+            x += lower;
+            return x;
         }
 
-        bigint randbi(bigint lower, bigint upper)
+        // a new generator with the same backend keyed from this one's stream,
+        // for handing independent streams to worker threads
+        prng fork()
         {
-            bigint a = randbi(16);
-            return map(a, 0, (bigint(2) ^ 16) - 1, lower, upper);
+            uint8_t seed[48];
+            fill(seed, sizeof(seed));
+            return prng(m_backend, seed);
         }
 
     private:
 
-        std::string m_seed;
-        std::mt19937 m_generator;
+        prng(rngBackend t_backend, const uint8_t seed[48])
+        {
+            init(t_backend, seed);
+        }
+
+        void init(rngBackend t_backend, const uint8_t seed[48])
+        {
+            m_backend = t_backend;
+            switch (t_backend)
+            {
+                case rngBackend::chacha20:
+                    m_engine.reset(new chachaEngine(seed));
+                    break;
+                case rngBackend::ctrDrbg:
+                    m_engine.reset(new ctrDrbgEngine(seed));
+                    break;
+                case rngBackend::mt19937:
+                    m_engine.reset(new mtEngine(seed));
+                    break;
+            }
+        }
+
+        rngBackend m_backend;
+        std::unique_ptr<randomEngine> m_engine;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
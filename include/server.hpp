@@ -16,10 +16,10 @@ namespace net
             if (keys == "")
             {
                 crypto::prng rng;
-                m_keys = crypto::genKeys(128, rng);
+                m_keys = crypto::genKeys(128, rng, std::thread::hardware_concurrency());
                 std::cout << m_keys.publicKey.n << std::endl;
             } else {
-                crypto::loadKeys(keys);
+                m_keys = crypto::loadKeys(keys);
             }
 
             m_port = t_port;
@@ -92,8 +92,11 @@ namespace net
                 exit(EXIT_FAILURE);
             }
 
-            // send the publci key to the recever
-            send(clientFd, &m_keys.publicKey, sizeof(crypto::rsaPublicKey), 0);
+            // send the publci key to the recever, as its length then the serialized key
+            std::string pubkey = crypto::serializePublicKey(m_keys.publicKey);
+            uint32_t length = htonl(pubkey.size());
+            send(clientFd, &length, sizeof(length), 0);
+            send(clientFd, pubkey.data(), pubkey.size(), 0);
             std::cout << m_keys.publicKey.n << std::endl;
 
             // delete responce buffer
@@ -0,0 +1,130 @@
+#ifndef shift_hpp
+#define shift_hpp
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CRYPTO_SHIFT_X86 1
+#endif
+
+// bytes of shift cipher key drawn at a time, held on the stack
+#ifndef CRYPTO_SHIFT_BLOCK
+#define CRYPTO_SHIFT_BLOCK 4096
+#endif
+
+namespace crypto
+{
+    // bytewise add and subtract of a key buffer into data, mod 256, for the shift cipher
+    // every kernel handles any length, the vector ones finish the tail with scalar
+    namespace shiftCodec
+    {
+        void addScalar(uint8_t *data, const uint8_t *key, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                data[i] += key[i];
+            }
+        }
+
+        void subScalar(uint8_t *data, const uint8_t *key, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                data[i] -= key[i];
+            }
+        }
+
+#ifdef CRYPTO_SHIFT_X86
+
+        void addSse2(uint8_t *data, const uint8_t *key, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+                __m128i k = _mm_loadu_si128((const __m128i *)(key + i));
+                _mm_storeu_si128((__m128i *)(data + i), _mm_add_epi8(d, k));
+            }
+            addScalar(data + i, key + i, n - i);
+        }
+
+        void subSse2(uint8_t *data, const uint8_t *key, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+                __m128i k = _mm_loadu_si128((const __m128i *)(key + i));
+                _mm_storeu_si128((__m128i *)(data + i), _mm_sub_epi8(d, k));
+            }
+            subScalar(data + i, key + i, n - i);
+        }
+
+        __attribute__((target("avx2")))
+        void addAvx2(uint8_t *data, const uint8_t *key, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+                __m256i k = _mm256_loadu_si256((const __m256i *)(key + i));
+                _mm256_storeu_si256((__m256i *)(data + i), _mm256_add_epi8(d, k));
+            }
+            addSse2(data + i, key + i, n - i);
+        }
+
+        __attribute__((target("avx2")))
+        void subAvx2(uint8_t *data, const uint8_t *key, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+                __m256i k = _mm256_loadu_si256((const __m256i *)(key + i));
+                _mm256_storeu_si256((__m256i *)(data + i), _mm256_sub_epi8(d, k));
+            }
+            subSse2(data + i, key + i, n - i);
+        }
+
+#endif
+
+        typedef void (*shiftFn)(uint8_t *, const uint8_t *, size_t);
+
+        // the widest kernels this cpu runs, picked on first use
+        shiftFn bestAdd()
+        {
+#ifdef CRYPTO_SHIFT_X86
+            static const shiftFn fn = __builtin_cpu_supports("avx2") ? addAvx2 : addSse2;
+            return fn;
+#else
+            return addScalar;
+#endif
+        }
+
+        shiftFn bestSub()
+        {
+#ifdef CRYPTO_SHIFT_X86
+            static const shiftFn fn = __builtin_cpu_supports("avx2") ? subAvx2 : subSse2;
+            return fn;
+#else
+            return subScalar;
+#endif
+        }
+    }
+
+    // data[i] += key[i] mod 256 for n bytes
+    void shiftAdd(uint8_t *data, const uint8_t *key, size_t n)
+    {
+        shiftCodec::bestAdd()(data, key, n);
+    }
+
+    // data[i] -= key[i] mod 256 for n bytes
+    void shiftSub(uint8_t *data, const uint8_t *key, size_t n)
+    {
+        shiftCodec::bestSub()(data, key, n);
+    }
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef signed_hpp
+#define signed_hpp
+
+#include <iostream>
+
+#include <types.hpp>
+
+namespace crypto
+{
+    // signed big integer, a bigint magnitude and a sign
+    // all the arithmetic is done by bigint on the magnitude, zero is never negative
+    class signedBigint
+    {
+    public:
+
+        signedBigint(long long n = 0) : m_magnitude(n < 0 ? -(unsigned long long)n : n), m_negative(n < 0) {}
+
+        signedBigint(const bigint &magnitude, bool negative = false) : m_magnitude(magnitude), m_negative(negative)
+        {
+            normalize();
+        }
+
+        signedBigint(bigint &&magnitude, bool negative = false) : m_magnitude(std::move(magnitude)), m_negative(negative)
+        {
+            normalize();
+        }
+
+        const bigint &magnitude() const
+        {
+            return m_magnitude;
+        }
+
+        bool negative() const
+        {
+            return m_negative;
+        }
+
+        // the value reduced into [0, m)
+        bigint mod(const bigint &m) const
+        {
+            bigint r = m_magnitude % m;
+            if (m_negative && !null(r))
+            {
+                r = m - std::move(r);
+            }
+            return r;
+        }
+
+        signedBigint operator-() const
+        {
+            return signedBigint(m_magnitude, !m_negative);
+        }
+
+        signedBigint &operator+=(const signedBigint &other)
+        {
+            addSigned(other.m_magnitude, other.m_negative);
+            return *this;
+        }
+
+        signedBigint &operator-=(const signedBigint &other)
+        {
+            addSigned(other.m_magnitude, !other.m_negative);
+            return *this;
+        }
+
+        signedBigint &operator*=(const signedBigint &other)
+        {
+            m_magnitude *= other.m_magnitude;
+            m_negative = m_negative != other.m_negative;
+            normalize();
+            return *this;
+        }
+
+        // scale by a non negative bigint without wrapping it first
+        signedBigint &operator*=(const bigint &x)
+        {
+            m_magnitude *= x;
+            normalize();
+            return *this;
+        }
+
+        friend signedBigint operator+(const signedBigint &a, const signedBigint &b)
+        {
+            signedBigint r(a);
+            r += b;
+            return r;
+        }
+
+        friend signedBigint operator-(const signedBigint &a, const signedBigint &b)
+        {
+            signedBigint r(a);
+            r -= b;
+            return r;
+        }
+
+        friend signedBigint operator*(const signedBigint &a, const signedBigint &b)
+        {
+            signedBigint r(a);
+            r *= b;
+            return r;
+        }
+
+        friend bool operator==(const signedBigint &a, const signedBigint &b)
+        {
+            return a.m_negative == b.m_negative && a.m_magnitude == b.m_magnitude;
+        }
+
+        friend bool operator!=(const signedBigint &a, const signedBigint &b)
+        {
+            return !(a == b);
+        }
+
+        friend bool operator<(const signedBigint &a, const signedBigint &b)
+        {
+            if (a.m_negative != b.m_negative)
+            {
+                return a.m_negative;
+            }
+            return a.m_negative ? b.m_magnitude < a.m_magnitude : a.m_magnitude < b.m_magnitude;
+        }
+
+        friend void swap(signedBigint &a, signedBigint &b) noexcept
+        {
+            swap(a.m_magnitude, b.m_magnitude);
+            std::swap(a.m_negative, b.m_negative);
+        }
+
+        friend std::ostream &operator<<(std::ostream &out, const signedBigint &a)
+        {
+            if (a.m_negative)
+            {
+                out << '-';
+            }
+            return out << a.m_magnitude;
+        }
+
+    private:
+
+        // this += (-1)^negative x, subtracting the smaller magnitude from the larger
+        // all three cases work in the existing storage
+        void addSigned(const bigint &x, bool negative)
+        {
+            if (m_negative == negative)
+            {
+                m_magnitude += x;
+            } else if (m_magnitude >= x) {
+                m_magnitude -= x;
+            } else {
+                m_magnitude = x - std::move(m_magnitude);
+                m_negative = negative;
+            }
+            normalize();
+        }
+
+        void normalize()
+        {
+            if (null(m_magnitude))
+            {
+                m_negative = false;
+            }
+        }
+
+        bigint m_magnitude;
+        bool m_negative;
+    };
+}
+
+#endif
@@ -15,5 +15,8 @@
 #define REQUEST_PUBKEY 0b00000001
 #define REQUEST_SEED   0b00000010
 
+// largest serialized public key a client accepts in the handshake
+#define MAX_PUBKEY_LENGTH 8192
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,489 @@
+#ifndef storage_hpp
+#define storage_hpp
+
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include <limbs.hpp>
+
+// limbs a bigint holds inline before it spills to the heap
+#ifndef CRYPTO_BIGINT_INLINE_LIMBS
+#define CRYPTO_BIGINT_INLINE_LIMBS 4
+#endif
+
+// limbs in the first block of a scratch arena
+#ifndef CRYPTO_ARENA_LIMBS
+#define CRYPTO_ARENA_LIMBS 16384
+#endif
+
+namespace crypto
+{
+    // opt in scoped bump allocator for bigint storage
+    // while one is alive, every bigint on this thread that spills to the heap
+    // takes its limbs from the arena instead, so a modexp or a prime search
+    // runs out of one contiguous block and never touches the global allocator
+    // memory is only reclaimed when the arena or a scratchScope inside it ends;
+    // values still holding arena memory then (results declared outside the scope,
+    // thread local buffers) are moved to the heap, so nothing dangles
+    // a loop that runs for long, like a prime search, should open a scratchScope
+    // per iteration so the arena stays at the size of one iteration's working set
+    // arenas nest, the innermost one is used, and values holding arena memory
+    // must stay on the thread that made them until the scope ends
+    //
+    //   bigint r;
+    //   {
+    //       scratchArena arena;
+    //       r = power(x, y, n);
+    //   }
+    class scratchArena
+    {
+    public:
+
+        // a position in the arena to rewind to
+        struct mark
+        {
+            size_t block;
+            size_t used;
+            size_t stamp;
+        };
+
+        explicit scratchArena(size_t limbs = CRYPTO_ARENA_LIMBS) : m_current(0), m_used(0), m_stamp(0), m_free(none), m_previous(active())
+        {
+            // reuse the block the last arena on this thread left behind
+            block &cached = spare();
+            if (cached.size >= limbs)
+            {
+                m_blocks.push_back(std::move(cached));
+                cached.size = 0;
+            } else {
+                m_blocks.push_back({std::unique_ptr<limb_t[]>(new limb_t[limbs]), limbs});
+            }
+            m_tracked.reserve(256);
+            active() = this;
+        }
+
+        scratchArena(const scratchArena &) = delete;
+        scratchArena &operator=(const scratchArena &) = delete;
+
+        ~scratchArena()
+        {
+            for (tracked &t : m_tracked)
+            {
+                if (t.buffer)
+                {
+                    t.evict(t.buffer);
+                }
+            }
+
+            // keep the largest block warm for the next arena
+            block &cached = spare();
+            for (block &b : m_blocks)
+            {
+                if (b.size > cached.size)
+                {
+                    cached = std::move(b);
+                }
+            }
+            active() = m_previous;
+        }
+
+        // the innermost arena on this thread, or null
+        static scratchArena *current()
+        {
+            return active();
+        }
+
+        // n limbs from the end of the current block
+        // when it is full the next block kept from before a rewind is used,
+        // or a new one at least twice as large as the last is started
+        limb_t *allocate(size_t n)
+        {
+            while (m_used + n > m_blocks[m_current].size)
+            {
+                if (m_current + 1 == m_blocks.size())
+                {
+                    size_t size = std::max(n, 2 * m_blocks.back().size);
+                    m_blocks.push_back({std::unique_ptr<limb_t[]>(new limb_t[size]), size});
+                }
+                m_current++;
+                m_used = 0;
+            }
+            limb_t *p = m_blocks[m_current].data.get() + m_used;
+            m_used += n;
+            m_stamp++;
+            return p;
+        }
+
+        // registers a buffer holding the memory of the last allocation, evict moves it to the heap
+        // returns the slot the buffer uses to update or drop its entry
+        // slots are reused once dropped, so the table only grows with the number of live buffers
+        size_t track(void *buffer, void (*evict)(void *))
+        {
+            size_t slot = m_free;
+            if (slot == none)
+            {
+                slot = m_tracked.size();
+                m_tracked.push_back({});
+            } else {
+                m_free = m_tracked[slot].next;
+            }
+            m_tracked[slot] = {buffer, evict, m_stamp, none};
+            return slot;
+        }
+
+        // the memory in slot now belongs to buffer
+        void retarget(size_t slot, void *buffer)
+        {
+            m_tracked[slot].buffer = buffer;
+        }
+
+        // the memory in slot is no longer used
+        void untrack(size_t slot)
+        {
+            m_tracked[slot].buffer = nullptr;
+            m_tracked[slot].next = m_free;
+            m_free = slot;
+        }
+
+        mark position() const
+        {
+            return {m_current, m_used, m_stamp};
+        }
+
+        // hands back everything allocated since m, moving buffers that still hold
+        // some of it to the heap first, the blocks are kept for the next allocations
+        void rewind(const mark &m)
+        {
+            for (size_t slot = 0; slot < m_tracked.size(); slot++)
+            {
+                tracked &t = m_tracked[slot];
+                if (t.buffer && t.stamp > m.stamp)
+                {
+                    t.evict(t.buffer);
+                    untrack(slot);
+                }
+            }
+            m_current = m.block;
+            m_used = m.used;
+            m_stamp = m.stamp;
+        }
+
+    private:
+
+        struct block
+        {
+            std::unique_ptr<limb_t[]> data;
+            size_t size;
+        };
+
+        // a live buffer, or a free slot linking to the next one through next
+        struct tracked
+        {
+            void *buffer;
+            void (*evict)(void *);
+            size_t stamp;
+            size_t next;
+        };
+
+        static constexpr size_t none = ~(size_t)0;
+
+        static scratchArena *&active()
+        {
+            static thread_local scratchArena *arena = nullptr;
+            return arena;
+        }
+
+        static block &spare()
+        {
+            static thread_local block cached = {nullptr, 0};
+            return cached;
+        }
+
+        std::vector<block> m_blocks;
+        size_t m_current;
+        size_t m_used;
+
+        // allocations made so far, each tracked buffer records the count at its own
+        size_t m_stamp;
+        std::vector<tracked> m_tracked;
+        size_t m_free;
+        scratchArena *m_previous;
+    };
+
+    // rewinds the current scratchArena to where it stood when the scope began
+    // for the body of a long loop: temporaries of one iteration give their memory
+    // back at its end, and any still alive then move to the heap
+    // the per thread buffers * and % trade storage with are among those, so an
+    // iteration costs a couple of heap allocations in exchange for a bounded arena
+    // does nothing when no arena is active
+    //
+    //   scratchArena arena;
+    //   while (!found)
+    //   {
+    //       scratchScope iteration;
+    //       found = isProbablePrime(search.next(), rng);
+    //   }
+    class scratchScope
+    {
+    public:
+
+        scratchScope() : m_arena(scratchArena::current())
+        {
+            if (m_arena)
+            {
+                m_mark = m_arena->position();
+            }
+        }
+
+        scratchScope(const scratchScope &) = delete;
+        scratchScope &operator=(const scratchScope &) = delete;
+
+        ~scratchScope()
+        {
+            if (m_arena)
+            {
+                m_arena->rewind(m_mark);
+            }
+        }
+
+    private:
+
+        scratchArena *m_arena;
+        scratchArena::mark m_mark;
+    };
+
+    // growable limb array keeping up to N limbs inside the object itself
+    // only values longer than N limbs touch the heap, so small exponents,
+    // counters and witnesses never allocate
+    // longer storage comes from the current scratchArena when there is one
+    // the subset of the std::vector interface bigint uses
+    template <size_t N>
+    class limbBuffer
+    {
+        static_assert(N > 0, "limbBuffer needs at least one inline limb");
+
+    public:
+
+        limbBuffer() : m_data(m_inline), m_size(0), m_capacity(N), m_arena(nullptr), m_slot(0) {}
+
+        explicit limbBuffer(size_t n, limb_t value = 0) : limbBuffer()
+        {
+            assign(n, value);
+        }
+
+        limbBuffer(const limbBuffer &other) : limbBuffer()
+        {
+            assign(other.begin(), other.end());
+        }
+
+        limbBuffer(limbBuffer &&other) noexcept : limbBuffer()
+        {
+            take(other);
+        }
+
+        ~limbBuffer()
+        {
+            release();
+        }
+
+        limbBuffer &operator=(const limbBuffer &other)
+        {
+            if (this != &other)
+            {
+                assign(other.begin(), other.end());
+            }
+            return *this;
+        }
+
+        limbBuffer &operator=(limbBuffer &&other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                take(other);
+            }
+            return *this;
+        }
+
+        size_t size() const { return m_size; }
+        size_t capacity() const { return m_capacity; }
+        bool empty() const { return m_size == 0; }
+
+        limb_t *data() { return m_data; }
+        const limb_t *data() const { return m_data; }
+        limb_t *begin() { return m_data; }
+        const limb_t *begin() const { return m_data; }
+        limb_t *end() { return m_data + m_size; }
+        const limb_t *end() const { return m_data + m_size; }
+
+        limb_t &operator[](size_t i) { return m_data[i]; }
+        const limb_t &operator[](size_t i) const { return m_data[i]; }
+        limb_t &back() { return m_data[m_size - 1]; }
+        const limb_t &back() const { return m_data[m_size - 1]; }
+
+        // grow the storage to hold at least n limbs, at least doubling it
+        void reserve(size_t n)
+        {
+            if (n <= m_capacity)
+            {
+                return;
+            }
+
+            size_t capacity = std::max(n, 2 * m_capacity);
+            scratchArena *arena = scratchArena::current();
+            limb_t *data = arena ? arena->allocate(capacity) : new limb_t[capacity];
+            std::copy(m_data, m_data + m_size, data);
+            size_t size = m_size;
+            release();
+            m_data = data;
+            m_size = size;
+            m_capacity = capacity;
+            if (arena)
+            {
+                m_arena = arena;
+                m_slot = arena->track(this, &evict);
+            }
+        }
+
+        void resize(size_t n, limb_t value = 0)
+        {
+            reserve(n);
+            if (n > m_size)
+            {
+                std::fill(m_data + m_size, m_data + n, value);
+            }
+            m_size = n;
+        }
+
+        void assign(size_t n, limb_t value)
+        {
+            reserve(n);
+            std::fill(m_data, m_data + n, value);
+            m_size = n;
+        }
+
+        // the range must not come from this buffer's own storage
+        template <class It, class = typename std::iterator_traits<It>::iterator_category>
+        void assign(It first, It last)
+        {
+            size_t n = std::distance(first, last);
+            reserve(n);
+            std::copy(first, last, m_data);
+            m_size = n;
+        }
+
+        void push_back(limb_t value)
+        {
+            reserve(m_size + 1);
+            m_data[m_size++] = value;
+        }
+
+        void pop_back()
+        {
+            m_size--;
+        }
+
+        // heap buffers trade pointers, inline ones are copied
+        void swap(limbBuffer &other) noexcept
+        {
+            if (!isInline() && !other.isInline())
+            {
+                std::swap(m_data, other.m_data);
+                std::swap(m_size, other.m_size);
+                std::swap(m_capacity, other.m_capacity);
+                std::swap(m_arena, other.m_arena);
+                std::swap(m_slot, other.m_slot);
+                retarget();
+                other.retarget();
+                return;
+            }
+
+            limbBuffer t(std::move(other));
+            other = std::move(*this);
+            *this = std::move(t);
+        }
+
+        friend bool operator==(const limbBuffer &a, const limbBuffer &b)
+        {
+            return a.m_size == b.m_size && std::equal(a.begin(), a.end(), b.begin());
+        }
+
+    private:
+
+        bool isInline() const
+        {
+            return m_data == m_inline;
+        }
+
+        // free any heap storage, leaving an empty inline buffer
+        // arena memory is only handed back to the arena's bookkeeping
+        void release()
+        {
+            if (m_arena)
+            {
+                m_arena->untrack(m_slot);
+                m_arena = nullptr;
+            } else if (!isInline()) {
+                delete[] m_data;
+            }
+            m_data = m_inline;
+            m_size = 0;
+            m_capacity = N;
+        }
+
+        // move other's contents into this empty inline buffer, leaving other empty
+        void take(limbBuffer &other)
+        {
+            if (other.isInline())
+            {
+                std::copy(other.m_data, other.m_data + other.m_size, m_inline);
+                m_size = other.m_size;
+            } else {
+                m_data = other.m_data;
+                m_size = other.m_size;
+                m_capacity = other.m_capacity;
+                m_arena = other.m_arena;
+                m_slot = other.m_slot;
+                retarget();
+                other.m_data = other.m_inline;
+                other.m_capacity = N;
+                other.m_arena = nullptr;
+            }
+            other.m_size = 0;
+        }
+
+        // point the arena entry for this buffer's memory back at it after a move
+        void retarget()
+        {
+            if (m_arena)
+            {
+                m_arena->retarget(m_slot, this);
+            }
+        }
+
+        // called by an ending arena, copies arena memory to the heap
+        static void evict(void *p)
+        {
+            limbBuffer *buffer = static_cast<limbBuffer *>(p);
+            limb_t *data = new limb_t[buffer->m_capacity];
+            std::copy(buffer->m_data, buffer->m_data + buffer->m_size, data);
+            buffer->m_data = data;
+            buffer->m_arena = nullptr;
+        }
+
+        limb_t *m_data;
+        size_t m_size;
+        size_t m_capacity;
+
+        // the arena m_data came from and its slot there, null for inline or heap memory
+        scratchArena *m_arena;
+        size_t m_slot;
+
+        limb_t m_inline[N];
+    };
+}
+
+#endif
@@ -3,31 +3,67 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <memory>
+#include <cstring>
+
+#include <limbs.hpp>
+#include <storage.hpp>
 
 namespace crypto
 {
+    struct divmodResult;
+
+    // order of the bytes in a raw byte import or export
+    enum class byteOrder
+    {
+        big,
+        little
+    };
+
     class bigint
     {
     private:
 
-        std::string digits;
+        // base 2^64 limbs, least significant first
+        // always holds at least one limb, with no leading zero limbs
+        // short values live inside the object, see CRYPTO_BIGINT_INLINE_LIMBS
+        limbBuffer<CRYPTO_BIGINT_INLINE_LIMBS> limbs;
+
+        // remove leading zero limbs
+        void trim();
+
+        // in place a = a * m + c
+        void mulSmall(limb_t m, limb_t c = 0);
+
+        // in place a = a / d, returns a % d
+        limb_t divSmall(limb_t d);
 
     public:
 
         // Constructors
         bigint(unsigned long long n = 0);
         bigint(std::string s);
-        bigint(bigint &);
+        bigint(const bigint &);
+        bigint(bigint &&) noexcept;
 
         // Helper Functions:
         friend void divideBy2(bigint &a);
         friend bool null(const bigint &);
         friend int length(const bigint &);
-        int operator[](const int)const;
-        std::string value();
+        friend int bitLength(const bigint &);
+        friend bool testBit(const bigint &, int);
+        friend int trailingZeros(const bigint &);
+        friend bigint shiftRight(const bigint &, int);
+        friend bigint shiftLeft(const bigint &, int);
+        limb_t operator[](const int)const;
+        std::string value() const;
 
         // Direct assignment
         bigint &operator=(const bigint &);
+        bigint &operator=(bigint &&) noexcept;
+        friend void swap(bigint &, bigint &) noexcept;
 
         // Post/Pre - Incrementation
         bigint &operator++();
@@ -39,12 +75,13 @@ namespace crypto
         friend bigint &operator+=(bigint &, const bigint &);
         friend bigint operator+(const bigint &, const bigint &);
         friend bigint operator-(const bigint &, const bigint &);
+        friend bigint operator-(const bigint &, bigint &&);
         friend bigint &operator-=(bigint &, const bigint &);
 
         // Comparison operators
         friend bool operator==(const bigint &, const bigint &);
         friend bool operator!=(const bigint &, const bigint &);
-    
+
         friend bool operator>(const bigint &, const bigint &);
         friend bool operator>=(const bigint &, const bigint &);
         friend bool operator<(const bigint &, const bigint &);
@@ -55,26 +92,44 @@ namespace crypto
         friend bigint operator*(const bigint &, const bigint &);
         friend bigint &operator/=(bigint &, const bigint &);
         friend bigint operator/(const bigint &, const bigint &);
-    
+        friend divmodResult divmod(const bigint &, const bigint &);
+        friend void divmod(const bigint &, const bigint &, bigint &, bigint &);
+        friend limb_t modSmall(const bigint &, limb_t);
+
         // Modulo
-        friend bigint operator%(const bigint, const bigint);
+        friend bigint operator%(const bigint &, const bigint &);
         friend bigint &operator%=(bigint &, const bigint &);
-    
+
         // Power Function
         friend bigint &operator^=(bigint &,const bigint &);
-        friend bigint operator^(bigint &, const bigint &);
+        friend bigint operator^(const bigint &, const bigint &);
+
+        // Modular Inverse
+        friend bigint secureInverse(const bigint &, const bigint &);
 
         // Square Root Function
-        friend bigint sqrt(bigint &a);
+        friend bigint sqrt(const bigint &a);
 
         // min, max
-        friend bigint min(bigint &a, bigint &b);
-        friend bigint max(bigint &a, bigint &b);
+        friend bigint min(const bigint &a, const bigint &b);
+        friend bigint max(const bigint &a, const bigint &b);
+
+        // Conversion to and from base 2, 10 and 16 digit strings
+        friend size_t digitCount(const bigint &, int);
+        friend void writeDigits(const bigint &, int, char *, size_t);
+        friend bigint readDigits(const char *, size_t, int);
+        friend void writeDecimal(const bigint &, char *, size_t, const std::vector<bigint> &, int);
+        friend bigint readDecimal(const char *, size_t, const std::vector<bigint> &);
+
+        // Raw bytes
+        friend size_t byteLength(const bigint &);
+        friend bigint fromBytes(const uint8_t *, size_t, byteOrder);
+        friend void toBytes(const bigint &, uint8_t *, size_t, byteOrder);
 
         // toHex, hexToBigint
-        friend std::string bigintToHex(bigint in);
-        friend std::string bigintToHex(bigint in, int bytes);
-        friend bigint hexToBigint(std::string hex);
+        friend std::string bigintToHex(const bigint &in);
+        friend std::string bigintToHex(const bigint &in, int bytes);
+        friend bigint hexToBigint(const std::string &hex);
 
         // Read and Write
         friend std::ostream &operator<<(std::ostream &,const bigint &);
@@ -83,38 +138,101 @@ namespace crypto
         // Others
         friend bigint factorial(int n);
         friend bigint map(bigint x, bigint a, bigint b, bigint c, bigint d);
+
+        // works on the limbs directly
+        friend class montgomeryContext;
+        friend class gcdEngine;
+        friend class prng;
+        template <size_t> friend class fixedUint;
+    };
+
+    // number of digits a has in base 2, 10 or 16, an upper bound in base 10
+    size_t digitCount(const bigint &a, int base);
+
+    // writes a into out as exactly width digits of base 2, 10 or 16,
+    // most significant first and padded with leading zeros
+    // throws if a needs more than width digits
+    void writeDigits(const bigint &a, int base, char *out, size_t width);
+
+    // the value of the n digits of base 2, 10 or 16 at in, either letter case for hex
+    bigint readDigits(const char *in, size_t n, int base);
+
+    // number of bytes needed to hold a, 0 for zero
+    size_t byteLength(const bigint &a);
+
+    // the value of the n bytes at in, read in the given order
+    bigint fromBytes(const uint8_t *in, size_t n, byteOrder order = byteOrder::big);
+
+    // writes a into exactly n bytes at out in the given order, zero padded
+    // throws if a needs more than n bytes
+    void toBytes(const bigint &a, uint8_t *out, size_t n, byteOrder order = byteOrder::big);
+
+    // quotient and remainder of a single long division
+    struct divmodResult
+    {
+        bigint quotient;
+        bigint remainder;
     };
 
     bigint::bigint(unsigned long long nr)
     {
-        do {
-            digits.push_back(nr % 10);
-            nr /= 10;
-        } while (nr);
+        limbs.push_back(nr);
     }
 
     bigint::bigint(std::string s)
     {
-        digits = "";
-        int n = s.size();
-        for (int i = n - 1; i >= 0;i--)
+        *this = readDigits(s.data(), s.size(), 10);
+    }
+
+    bigint::bigint(const bigint &a) : limbs(a.limbs) {}
+
+    // the moved from value is left as zero, not empty
+    bigint::bigint(bigint &&a) noexcept : limbs(std::move(a.limbs))
+    {
+        a.limbs.assign(1, 0);
+    }
+
+    void bigint::trim()
+    {
+        while (limbs.size() > 1 && limbs.back() == 0)
         {
-            if (!isdigit(s[i]))
-            {
-                throw("ERROR");
-            }
-            digits.push_back(s[i] - '0');
+            limbs.pop_back();
+        }
+    }
+
+    void bigint::mulSmall(limb_t m, limb_t c)
+    {
+        for (size_t i = 0; i < limbs.size(); i++)
+        {
+            dlimb_t s = (dlimb_t)limbs[i] * m + c;
+            limbs[i] = (limb_t)s;
+            c = (limb_t)(s >> 64);
         }
+
+        if (c)
+        {
+            limbs.push_back(c);
+        }
+        trim();
     }
 
-    bigint::bigint(bigint &a)
+    limb_t bigint::divSmall(limb_t d)
     {
-        digits = a.digits;
+        dlimb_t rem = 0;
+        for (size_t i = limbs.size(); i-- > 0;)
+        {
+            dlimb_t cur = (rem << 64) | limbs[i];
+            limbs[i] = (limb_t)(cur / d);
+            rem = cur % d;
+        }
+
+        trim();
+        return (limb_t)rem;
     }
 
     bool null(const bigint& a)
     {
-        if (a.digits.size() == 1 && a.digits[0] == 0)
+        if (a.limbs.size() == 1 && a.limbs[0] == 0)
         {
             return true;
         }
@@ -123,32 +241,104 @@ namespace crypto
 
     int length(const bigint & a)
     {
-        return a.digits.size();
+        return a.limbs.size();
     }
 
-    int bigint::operator[] (const int index) const
+    int bitLength(const bigint &a)
     {
-        if (digits.size() <= index || index < 0)
+        if (null(a))
         {
-            throw("ERROR");
+            return 0;
+        }
+
+        return 64 * (a.limbs.size() - 1) + (64 - __builtin_clzll(a.limbs.back()));
+    }
+
+    bool testBit(const bigint &a, int i)
+    {
+        if ((size_t)i / 64 >= a.limbs.size())
+        {
+            return false;
+        }
+
+        return (a.limbs[i / 64] >> (i % 64)) & 1;
+    }
+
+    // number of trailing zero bits, 0 for zero
+    int trailingZeros(const bigint &a)
+    {
+        for (size_t i = 0; i < a.limbs.size(); i++)
+        {
+            if (a.limbs[i])
+            {
+                return 64 * i + __builtin_ctzll(a.limbs[i]);
+            }
+        }
+        return 0;
+    }
+
+    // a / 2^bits
+    bigint shiftRight(const bigint &a, int bits)
+    {
+        bigint r;
+        size_t limbShift = bits / 64;
+        if (limbShift >= a.limbs.size())
+        {
+            return r;
+        }
+
+        r.limbs.assign(a.limbs.begin() + limbShift, a.limbs.end());
+        if (bits % 64)
+        {
+            limbs::rshift(r.limbs.data(), r.limbs.data(), r.limbs.size(), bits % 64);
+        }
+        r.trim();
+        return r;
+    }
+
+    // a * 2^bits
+    bigint shiftLeft(const bigint &a, int bits)
+    {
+        bigint r;
+        if (null(a))
+        {
+            return r;
+        }
+
+        r.limbs.assign(bits / 64 + a.limbs.size(), 0);
+        std::copy(a.limbs.begin(), a.limbs.end(), r.limbs.begin() + bits / 64);
+        if (bits % 64)
+        {
+            limb_t out = limbs::lshift(&r.limbs[bits / 64], &r.limbs[bits / 64], a.limbs.size(), bits % 64);
+            if (out)
+            {
+                r.limbs.push_back(out);
+            }
         }
-        return digits[index];
+        return r;
     }
 
-    std::string bigint::value()
+    limb_t bigint::operator[] (const int index) const
     {
-        std::string val;
-        for (int i = 0; i < digits.size(); i++)
+        if (index < 0 || limbs.size() <= (size_t)index)
         {
-            val.insert(0, std::to_string(digits[i]));
+            throw("ERROR");
         }
+        return limbs[index];
+    }
 
+    std::string bigint::value() const
+    {
+        // write into the upper bound on the length, then drop the unused leading zeros
+        std::string val(digitCount(*this, 10), '0');
+        writeDigits(*this, 10, &val[0], val.size());
+        val.erase(0, std::min(val.find_first_not_of('0'), val.size() - 1));
         return val;
     }
 
     bool operator== (const bigint &a, const bigint &b)
     {
-        return a.digits == b.digits;
+        return a.limbs == b.limbs;
     }
 
     bool operator!= (const bigint &a, const bigint &b)
@@ -166,9 +356,9 @@ namespace crypto
 
         while(n--)
         {
-            if (a.digits[n] != b.digits[n])
+            if (a.limbs[n] != b.limbs[n])
             {
-                return a.digits[n] < b.digits[n];
+                return a.limbs[n] < b.limbs[n];
             }
         }
         return false;
@@ -191,23 +381,35 @@ namespace crypto
 
     bigint& bigint::operator= (const bigint &a)
     {
-        digits = a.digits;
+        limbs = a.limbs;
+        return *this;
+    }
+
+    bigint& bigint::operator= (bigint &&a) noexcept
+    {
+        limbs.swap(a.limbs);
         return *this;
     }
 
+    // exchanges storage, unlike std::swap this never allocates
+    void swap(bigint &a, bigint &b) noexcept
+    {
+        a.limbs.swap(b.limbs);
+    }
+
     bigint &bigint::operator++()
     {
-        int i, n = digits.size();
-        for (i = 0; i < n && digits[i] == 9;i++)
+        size_t i, n = limbs.size();
+        for (i = 0; i < n && limbs[i] == ~(limb_t)0;i++)
         {
-            digits[i] = 0;
+            limbs[i] = 0;
         }
 
         if (i == n)
         {
-            digits.push_back(1);
+            limbs.push_back(1);
         } else {
-            digits[i]++;
+            limbs[i]++;
         }
 
         return *this;
@@ -215,66 +417,61 @@ namespace crypto
 
     bigint bigint::operator++(int temp)
     {
-        bigint aux;
-        aux = *this;
+        bigint aux(*this);
         ++(*this);
         return aux;
     }
 
     bigint &bigint::operator--()
     {
-        if (digits[0] == 0 && digits.size() == 1)
+        if (null(*this))
         {
             throw("UNDERFLOW");
         }
 
-        int i, n = digits.size();
-        for (i = 0; digits[i] == 0 && i < n;i++)
+        size_t i, n = limbs.size();
+        for (i = 0; i < n && limbs[i] == 0;i++)
         {
-            digits[i] = 9;
+            limbs[i] = ~(limb_t)0;
         }
 
-        digits[i]--;
-        if (n > 1 && digits[n - 1] == 0)
-        {
-            digits.pop_back();
-        }
+        limbs[i]--;
+        trim();
 
         return *this;
     }
 
     bigint bigint::operator--(int temp)
     {
-        bigint aux;
-        aux = *this;
+        bigint aux(*this);
         --(*this);
         return aux;
     }
 
     bigint &operator+=(bigint &a,const bigint& b)
     {
-        int t = 0, s, i;
-        int n = length(a), m = length(b);
+        size_t n = a.limbs.size(), m = b.limbs.size();
         if (m > n)
         {
-            a.digits.append(m - n, 0);
+            a.limbs.resize(m, 0);
+            n = m;
         }
-        n = length(a);
-        for (i = 0; i < n;i++)
+
+        limb_t t = 0;
+        for (size_t i = 0; i < n && (i < m || t);i++)
         {
+            dlimb_t s = (dlimb_t)a.limbs[i] + t;
             if (i < m)
             {
-                s = (a.digits[i] + b.digits[i]) + t;
-            } else {
-                s = a.digits[i] + t;
+                s += b.limbs[i];
             }
-            t = s / 10;
-            a.digits[i] = (s % 10);
+            a.limbs[i] = (limb_t)s;
+            t = (limb_t)(s >> 64);
         }
 
         if (t)
         {
-            a.digits.push_back(t);
+            a.limbs.push_back(t);
         }
 
         return a;
@@ -282,12 +479,30 @@ namespace crypto
 
     bigint operator+(const bigint &a, const bigint &b)
     {
-        bigint temp;
-        temp = a;
+        bigint temp(a);
         temp += b;
         return temp;
     }
 
+    // temporaries on either side are reused as the result
+    bigint operator+(bigint &&a, const bigint &b)
+    {
+        a += b;
+        return std::move(a);
+    }
+
+    bigint operator+(const bigint &a, bigint &&b)
+    {
+        b += a;
+        return std::move(b);
+    }
+
+    bigint operator+(bigint &&a, bigint &&b)
+    {
+        a += b;
+        return std::move(a);
+    }
+
     bigint &operator-=(bigint &a, const bigint &b)
     {
         if (a < b)
@@ -295,88 +510,112 @@ namespace crypto
             throw("UNDERFLOW");
         }
 
-        int n = length(a), m = length(b);
-        int i, t = 0, s;
-        for (i = 0; i < n;i++)
+        size_t n = a.limbs.size(), m = b.limbs.size();
+        limb_t t = 0;
+        for (size_t i = 0; i < n && (i < m || t);i++)
         {
-            if (i < m)
-            {
-                s = a.digits[i] - b.digits[i]+ t;
-            } else {
-                s = a.digits[i]+ t;
-            }
-
-            if (s < 0)
-            {
-                s += 10,
-                t = -1;
-            } else {
-                t = 0;
-            }
-
-            a.digits[i] = s;
-        }
-
-        while (n > 1 && a.digits[n - 1] == 0)
-        {
-            a.digits.pop_back(),
-            n--;
+            limb_t s = (i < m) ? b.limbs[i] : 0;
+            limb_t d = a.limbs[i] - s - t;
+            t = (a.limbs[i] < s) || (a.limbs[i] - s < t);
+            a.limbs[i] = d;
         }
 
+        a.trim();
         return a;
     }
 
     bigint operator-(const bigint &a, const bigint &b)
     {
-        bigint temp;
-        temp = a;
+        bigint temp(a);
         temp -= b;
         return temp;
     }
 
+    bigint operator-(bigint &&a, const bigint &b)
+    {
+        a -= b;
+        return std::move(a);
+    }
+
+    // a - b computed into b's storage
+    bigint operator-(const bigint &a, bigint &&b)
+    {
+        if (a < b)
+        {
+            throw("UNDERFLOW");
+        }
+
+        size_t n = a.limbs.size(), m = b.limbs.size();
+        b.limbs.resize(n, 0);
+        limbs::sub(b.limbs.data(), a.limbs.data(), n, b.limbs.data(), m);
+        b.trim();
+        return std::move(b);
+    }
+
+    bigint operator-(bigint &&a, bigint &&b)
+    {
+        a -= b;
+        return std::move(a);
+    }
+
     bigint &operator*=(bigint &a, const bigint &b)
     {
         if (null(a) || null(b)){
-            a = bigint();
+            a.limbs.assign(1, 0);
             return a;
         }
 
-        int n = a.digits.size(), m = b.digits.size();
-        std::vector<int> v(n + m, 0);
-        for (int i = 0; i < n;i++)
-        {
-            for (int j = 0; j < m;j++)
-            {
-                v[i + j] += (a.digits[i] ) * (b.digits[j]);
-            }
-        }
-        n += m;
-        a.digits.resize(v.size());
-        for (int s, i = 0, t = 0; i < n; i++)
-        {
-            s = t + v[i];
-            v[i] = s % 10;
-            t = s / 10;
-            a.digits[i] = v[i] ;
-        }
-        
-        for (int i = n - 1; i >= 1 && !v[i];i--)
+        // one scratch buffer per thread, shared by every level of the recursion
+        static thread_local std::vector<limb_t> scratch;
+
+        // the product goes into a per thread buffer that then trades places
+        // with a, so a's old storage is reused by the next multiplication
+        static thread_local limbBuffer<CRYPTO_BIGINT_INLINE_LIMBS> product;
+
+        size_t n = a.limbs.size(), m = b.limbs.size();
+        size_t need = limbs::mulScratch(n, m);
+        if (scratch.size() < need)
         {
-            a.digits.pop_back();
+            scratch.resize(need);
         }
 
+        product.resize(n + m);
+        limbs::mul(product.data(), a.limbs.data(), n, b.limbs.data(), m, scratch.data());
+        a.limbs.swap(product);
+        a.trim();
+
         return a;
     }
 
     bigint operator*(const bigint &a, const bigint &b)
     {
-        bigint temp;
-        temp = a;
+        bigint temp(a);
         temp *= b;
         return temp;
     }
 
-    bigint &operator/=(bigint &a, const bigint &b)
+    bigint operator*(bigint &&a, const bigint &b)
+    {
+        a *= b;
+        return std::move(a);
+    }
+
+    bigint operator*(const bigint &a, bigint &&b)
+    {
+        b *= a;
+        return std::move(b);
+    }
+
+    bigint operator*(bigint &&a, bigint &&b)
+    {
+        a *= b;
+        return std::move(a);
+    }
+
+    // divides a by b in one pass, writing the quotient to q and the remainder to r
+    // uses knuth algorithm d, with a fast path for single limb divisors
+    // q and r reuse their existing storage and must not alias a or b
+    void divmod(const bigint &a, const bigint &b, bigint &q, bigint &r)
     {
         if (null(b))
         {
@@ -385,143 +624,178 @@ namespace crypto
 
         if (a < b)
         {
-            a = bigint();
-            return a;
+            q.limbs.assign(1, 0);
+            r = a;
+            return;
         }
 
-        if (a == b)
-        {
-            a = bigint(1);
-            return a;
-        }
+        size_t n = a.limbs.size(), m = b.limbs.size();
+        q.limbs.resize(n - m + 1);
 
-        int i, lgcat = 0, cc;
-        int n = length(a);
-        std::vector<int> cat(n, 0);
-        bigint t;
-        for (i = n - 1; t * 10 + a.digits[i]  < b;i--)
+        if (m == 1)
         {
-            t *= 10;
-            t += a.digits[i];
-        }
+            r.limbs.assign(1, limbs::divrem1(q.limbs.data(), a.limbs.data(), n, b.limbs[0]));
+        } else {
+            static thread_local std::vector<limb_t> scratch;
+            size_t need = limbs::divremScratch(n, m);
+            if (scratch.size() < need)
+            {
+                scratch.resize(need);
+            }
 
-        for (; i >= 0; i--)
-        {
-            t = t * 10 + a.digits[i];
-            for (cc = 9; cc * b > t;cc--);
-            t -= cc * b;
-            cat[lgcat++] = cc;
+            r.limbs.resize(m);
+            limbs::divrem(q.limbs.data(), r.limbs.data(), a.limbs.data(), n, b.limbs.data(), m, scratch.data());
+            r.trim();
         }
 
-        a.digits.resize(cat.size());
-        for (i = 0; i < lgcat;i++)
-        {
-            a.digits[i] = cat[lgcat - i - 1];
-        }
-        a.digits.resize(lgcat);
-        return a;
+        q.trim();
     }
 
-    bigint operator/(const bigint &a,const bigint &b)
+    // divides a by b in one pass, returning both quotient and remainder
+    divmodResult divmod(const bigint &a, const bigint &b)
     {
-        bigint temp;
-        temp = a;
-        temp /= b;
-        return temp;
+        divmodResult res;
+        divmod(a, b, res.quotient, res.remainder);
+        return res;
     }
 
-    bigint &operator%=(bigint &a, const bigint &b)
+    // a % d for a single limb divisor, without touching a
+    limb_t modSmall(const bigint &a, limb_t d)
     {
-        if (null(b))
+        if (d == 0)
         {
             throw("Arithmetic Error: Division By 0");
         }
 
-        if (a < b)
+        dlimb_t rem = 0;
+        for (size_t i = a.limbs.size(); i-- > 0;)
         {
-            return a;
+            rem = ((rem << 64) | a.limbs[i]) % d;
         }
+        return (limb_t)rem;
+    }
 
-        if (a == b)
-        {
-            a = bigint();
-            return a;
-        }
+    // per thread quotient and remainder, traded with a so repeated
+    // in place division keeps reusing the same storage
+    bigint &operator/=(bigint &a, const bigint &b)
+    {
+        static thread_local bigint q, r;
+        divmod(a, b, q, r);
+        a.limbs.swap(q.limbs);
+        return a;
+    }
 
-        int i, lgcat = 0, cc;
-        int n = length(a);
-        std::vector<int> cat(n, 0);
-        bigint t;
-        for (i = n - 1; t * 10 + a.digits[i] < b;i--)
-        {
-            t *= 10;
-            t += a.digits[i];
-        }
+    bigint operator/(const bigint &a,const bigint &b)
+    {
+        bigint temp(a);
+        temp /= b;
+        return temp;
+    }
 
-        for (; i >= 0; i--)
-        {
-            t = t * 10 + a.digits[i];
-            for (cc = 9; cc * b > t;cc--);
-            t -= cc * b;
-            cat[lgcat++] = cc;
-        }
+    bigint operator/(bigint &&a, const bigint &b)
+    {
+        a /= b;
+        return std::move(a);
+    }
 
-        a = t;
+    bigint &operator%=(bigint &a, const bigint &b)
+    {
+        static thread_local bigint q, r;
+        divmod(a, b, q, r);
+        a.limbs.swap(r.limbs);
         return a;
     }
 
-    bigint operator%(const bigint a, bigint b)
+    bigint operator%(const bigint &a, const bigint &b)
     {
-        bigint temp;
-        temp = a;
+        bigint temp(a);
         temp %= b;
         return temp;
     }
 
-    bigint &operator^=(bigint &a, const bigint &b)
+    bigint operator%(bigint &&a, const bigint &b)
     {
-        bigint Exponent, Base(a);
-        Exponent = b;
-        a = 1;
+        a %= b;
+        return std::move(a);
+    }
 
-        while(!null(Exponent))
+    bigint &operator^=(bigint &a, const bigint &b)
+    {
+        // sliding window over the exponent bits, copied in case b is a
+        limbBuffer<CRYPTO_BIGINT_INLINE_LIMBS> exponent(b.limbs);
+        int bits = bitLength(b);
+        int w = CRYPTO_EXP_WINDOW ? CRYPTO_EXP_WINDOW : limbs::windowSize(bits);
+
+        // odd powers a, a^3, a^5 ...
+        std::unique_ptr<bigint[]> table(new bigint[(size_t)1 << (w - 1)]);
+        table[0] = a;
+        if (w > 1)
         {
-            if (Exponent[0] & 1)
+            bigint square(a);
+            square *= a;
+            for (size_t i = 1; i < ((size_t)1 << (w - 1)); i++)
             {
-                a *= Base;
+                table[i] = table[i - 1];
+                table[i] *= square;
             }
-
-            Base *= Base;
-            divideBy2(Exponent);
         }
 
+        a = 1;
+        limbs::slidingWindow(exponent.data(), bits, w,
+            [&]() { a *= a; },
+            [&](size_t i) { a *= table[i]; });
+
         return a;
     }
 
-    bigint operator^(bigint a, bigint b)
+    bigint operator^(const bigint &a, const bigint &b)
     {
         bigint temp(a);
         temp ^= b;
         return temp;
     }
 
-    void divideBy2(bigint &a)
+    // a^-1 mod m for odd m in constant time, for secret a or m
+    // the running time only depends on the number of limbs in a and m,
+    // a of any size is reduced by the fixed step secReduce, never by a branch on a >= m
+    // returns 0 when a and m are not coprime
+    bigint secureInverse(const bigint &a, const bigint &m)
     {
-        int add = 0;
-        for (int i = a.digits.size() - 1; i >= 0;i--)
+        if (!(m.limbs[0] & 1))
+        {
+            throw("Arithmetic Error: Constant time inverse needs an odd modulus");
+        }
+
+        size_t n = m.limbs.size();
+        std::vector<limb_t> scratch(std::max(limbs::secInvertScratch(n), 2 * (n + 1)));
+        bigint x;
+        x.limbs.resize(n);
+        limbs::secReduce(x.limbs.data(), a.limbs.data(), a.limbs.size(), m.limbs.data(), n, scratch.data());
+
+        bigint r;
+        r.limbs.resize(n);
+        if (!limbs::secInvert(r.limbs.data(), x.limbs.data(), m.limbs.data(), n, scratch.data()))
         {
-            int digit = (a.digits[i] >> 1) + add;
-            add = ((a.digits[i] & 1) * 5);
-            a.digits[i] = digit;
+            return 0;
         }
+        r.trim();
+        return r;
+    }
 
-        while(a.digits.size() > 1 && !a.digits.back())
+    void divideBy2(bigint &a)
+    {
+        limb_t add = 0;
+        for (size_t i = a.limbs.size(); i-- > 0;)
         {
-            a.digits.pop_back();
+            limb_t limb = (a.limbs[i] >> 1) | add;
+            add = a.limbs[i] << 63;
+            a.limbs[i] = limb;
         }
+
+        a.trim();
     }
 
-    bigint sqrt(bigint & a)
+    bigint sqrt(const bigint &a)
     {
         bigint left(1), right(a), v(1), mid, prod;
         divideBy2(right);
@@ -546,7 +820,7 @@ namespace crypto
         return v;
     }
 
-    bigint min(bigint &a, bigint &b)
+    bigint min(const bigint &a, const bigint &b)
     {
         if (a < b)
         {
@@ -556,7 +830,7 @@ namespace crypto
         return b;
     }
 
-    bigint max(bigint &a, bigint &b)
+    bigint max(const bigint &a, const bigint &b)
     {
         if (a > b)
         {
@@ -566,48 +840,275 @@ namespace crypto
         return b;
     }
 
-    std::string bigintToHex(bigint in)
+    // value of a single digit character, or -1
+    int digitValue(char c)
     {
-        std::string hex;
-        std::string digits = "0123456789ABCDEF";
-        while (in != 0)
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        if (c >= 'a' && c <= 'f')
         {
-            hex.insert(0, std::string(1, digits[(std::stoi((in % 16).value()))]));
+            return c - 'a' + 10;
+        }
+        return -1;
+    }
 
-            in = in / 16;
+    // bits per digit for the power of two bases, 0 for base 10
+    int digitBits(int base)
+    {
+        switch (base)
+        {
+            case 2: return 1;
+            case 16: return 4;
+            case 10: return 0;
         }
+        throw("ERROR: unsupported base");
+    }
 
-        return hex;
+    // 10^19, 10^38, 10^76 ... while the digit count 19 2^k stays below digits
+    // the split points for the divide and conquer decimal conversion
+    std::vector<bigint> decimalPowers(size_t digits)
+    {
+        std::vector<bigint> powers(1, bigint(10000000000000000000ULL));
+        for (size_t d = 38; d < digits; d *= 2)
+        {
+            powers.push_back(powers.back() * powers.back());
+        }
+        return powers;
     }
 
-    std::string bigintToHex(bigint in, int bytes)
+    size_t digitCount(const bigint &a, int base)
     {
-        std::string hex = bigintToHex(in);
-        std::string res = std::string(bytes * 2, '0');
+        int bits = digitBits(base), n = std::max(bitLength(a), 1);
+        if (bits)
+        {
+            return (n + bits - 1) / bits;
+        }
+
+        // a < 2^n has at most n log10(2) + 1 digits, 1262612 / 2^22 is just above log10(2)
+        return ((size_t)n * 1262612 >> 22) + 1;
+    }
 
-        if (res.size() < hex.size())
+    // a < 10^width as width decimal digits
+    // above the threshold a is split at the largest 10^(19 2^k) no longer than
+    // about half of it, and both halves are written independently,
+    // small values peel off 19 digits at a time from the bottom
+    void writeDecimal(const bigint &a, char *out, size_t width, const std::vector<bigint> &powers, int level)
+    {
+        while (level > 0 && 2 * powers[level].limbs.size() > a.limbs.size() + 1)
         {
-            throw("ERROR");
+            level--;
         }
 
-        int j = res.size() - 1;
-        for (int i = hex.size() - 1; i >= 0; i--)
+        if (a.limbs.size() > CRYPTO_RADIX_THRESHOLD && level > 0)
         {
-            res[j--] = hex[i];
+            size_t digits = (size_t)19 << level;
+            if (digits >= width)
+            {
+                throw("ERROR: value does not fit the width");
+            }
+
+            bigint q, r;
+            divmod(a, powers[level], q, r);
+            writeDecimal(q, out, width - digits, powers, level);
+            writeDecimal(r, out + width - digits, digits, powers, level - 1);
+            return;
         }
 
-        return res;
+        bigint t(a);
+        size_t pos = width;
+        while (pos > 0)
+        {
+            limb_t chunk = null(t) ? 0 : t.divSmall(10000000000000000000ULL);
+            for (int i = 0; i < 19 && pos > 0; i++)
+            {
+                out[--pos] = '0' + chunk % 10;
+                chunk /= 10;
+            }
+            if (chunk)
+            {
+                throw("ERROR: value does not fit the width");
+            }
+        }
+
+        if (!null(t))
+        {
+            throw("ERROR: value does not fit the width");
+        }
     }
 
-    bigint hexToBigint(std::string hex)
+    void writeDigits(const bigint &a, int base, char *out, size_t width)
     {
-        bigint num;
-        for (int i = 0; i < hex.length(); i++)
+        static const char digits[] = "0123456789ABCDEF";
+        int bits = digitBits(base);
+        if (!bits)
+        {
+            std::vector<bigint> powers = decimalPowers(digitCount(a, 10));
+            writeDecimal(a, out, width, powers, powers.size() - 1);
+            return;
+        }
+
+        if ((size_t)bitLength(a) > width * bits)
         {
-            num += std::stoi(std::string(1, hex[i]), nullptr, 16) * (bigint(16) ^ (hex.length() - i - 1));
+            throw("ERROR: value does not fit the width");
         }
 
-        return num;
+        // every digit sits inside one limb, read them straight off the bits
+        limb_t mask = ((limb_t)1 << bits) - 1;
+        size_t perLimb = 64 / bits, n = a.limbs.size();
+        for (size_t i = 0; i < width; i++)
+        {
+            size_t limb = i / perLimb;
+            limb_t d = limb < n ? (a.limbs[limb] >> (i % perLimb * bits)) & mask : 0;
+            out[width - 1 - i] = digits[d];
+        }
+    }
+
+    // the n decimal digits at in
+    // long strings are split so the low part is 19 2^k digits, both halves are
+    // read independently and joined with one product
+    bigint readDecimal(const char *in, size_t n, const std::vector<bigint> &powers)
+    {
+        int level = powers.size() - 1;
+        while (level >= 0 && ((size_t)19 << level) >= n)
+        {
+            level--;
+        }
+
+        if (n > (size_t)19 * CRYPTO_RADIX_THRESHOLD && level >= 0)
+        {
+            size_t digits = (size_t)19 << level;
+            bigint r = readDecimal(in, n - digits, powers);
+            r *= powers[level];
+            r += readDecimal(in + n - digits, digits, powers);
+            return r;
+        }
+
+        // 19 digits at a time, the largest power of 10 that fits in a limb
+        bigint r;
+        for (size_t i = 0; i < n; i += 19)
+        {
+            limb_t chunk = 0, scale = 1;
+            for (size_t j = i; j < n && j < i + 19; j++)
+            {
+                int d = digitValue(in[j]);
+                if (d < 0 || d > 9)
+                {
+                    throw("ERROR");
+                }
+                chunk = chunk * 10 + d;
+                scale *= 10;
+            }
+            r.mulSmall(scale, chunk);
+        }
+        return r;
+    }
+
+    bigint readDigits(const char *in, size_t n, int base)
+    {
+        int bits = digitBits(base);
+        if (!bits)
+        {
+            return readDecimal(in, n, decimalPowers(n));
+        }
+
+        // the last character is the lowest digit, or each one straight into its limb
+        size_t perLimb = 64 / bits;
+        bigint r;
+        r.limbs.assign(std::max((n + perLimb - 1) / perLimb, (size_t)1), 0);
+        for (size_t i = 0; i < n; i++)
+        {
+            int d = digitValue(in[n - 1 - i]);
+            if (d < 0 || d >= base)
+            {
+                throw("ERROR");
+            }
+            r.limbs[i / perLimb] |= (limb_t)d << (i % perLimb * bits);
+        }
+        r.trim();
+        return r;
+    }
+
+    size_t byteLength(const bigint &a)
+    {
+        return (bitLength(a) + 7) / 8;
+    }
+
+    // byte i, counting from the least significant, lands in limb i / 8
+    bigint fromBytes(const uint8_t *in, size_t n, byteOrder order)
+    {
+        bigint r;
+        r.limbs.assign(std::max((n + 7) / 8, (size_t)1), 0);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // little endian bytes already are the limb layout
+        if (order == byteOrder::little && n)
+        {
+            std::memcpy(r.limbs.data(), in, n);
+            r.trim();
+            return r;
+        }
+#endif
+        for (size_t i = 0; i < n; i++)
+        {
+            limb_t b = order == byteOrder::little ? in[i] : in[n - 1 - i];
+            r.limbs[i / 8] |= b << (i % 8 * 8);
+        }
+        r.trim();
+        return r;
+    }
+
+    void toBytes(const bigint &a, uint8_t *out, size_t n, byteOrder order)
+    {
+        if (byteLength(a) > n)
+        {
+            throw("ERROR: value does not fit the buffer");
+        }
+
+        size_t limbCount = a.limbs.size();
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if (order == byteOrder::little && n)
+        {
+            size_t used = std::min(n, 8 * limbCount);
+            std::memcpy(out, a.limbs.data(), used);
+            std::memset(out + used, 0, n - used);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; i++)
+        {
+            uint8_t b = i / 8 < limbCount ? (uint8_t)(a.limbs[i / 8] >> (i % 8 * 8)) : 0;
+            if (order == byteOrder::little)
+            {
+                out[i] = b;
+            } else {
+                out[n - 1 - i] = b;
+            }
+        }
+    }
+
+    // zero has no digits and gives an empty string
+    std::string bigintToHex(const bigint &in)
+    {
+        std::string hex((bitLength(in) + 3) / 4, '0');
+        writeDigits(in, 16, &hex[0], hex.size());
+        return hex;
+    }
+
+    std::string bigintToHex(const bigint &in, int bytes)
+    {
+        std::string hex(bytes * 2, '0');
+        writeDigits(in, 16, &hex[0], hex.size());
+        return hex;
+    }
+
+    bigint hexToBigint(const std::string &hex)
+    {
+        return readDigits(hex.data(), hex.size(), 16);
     }
 
     bigint factorial(int n)
@@ -617,7 +1118,7 @@ namespace crypto
         {
             f *= i;
         }
-        
+
         return f;
     }
 
@@ -630,27 +1131,24 @@ namespace crypto
     {
         std::string s;
         in >> s;
-        int n = s.size();
 
-        for (int i = n - 1; i >= 0;i--)
+        for (char c : s)
         {
-            if (!isdigit(s[i]))
+            if (!isdigit(c))
             {
                 throw("INVALID NUMBER");
             }
-            a.digits[n - i - 1] = s[i];
         }
+
+        a = bigint(s);
         return in;
     }
-    
+
     std::ostream &operator<<(std::ostream &out, const crypto::bigint &a)
     {
-        for (int i = a.digits.size() - 1; i >= 0;i--)
-        {
-            out << (short)a.digits[i];
-        }
+        out << a.value();
         return out;
     }
 }
 
-#endif
\ No newline at end of file
+#endif